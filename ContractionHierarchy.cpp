@@ -0,0 +1,668 @@
+#include "provided.h"
+#include "ContractionHierarchy.h"
+#include "IndexedHeap.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    const char HIERARCHY_MAGIC[8] = { 'G', 'O', 'O', 'B', 'C', 'H', '\0', '\0' };
+    const uint32_t HIERARCHY_VERSION = 1;
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    //followed by the arrays in the order save writes them
+    struct HierarchyHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t fingerprint;
+        uint32_t nodeCount;
+        uint32_t edgeCount;
+        uint32_t arcCount;
+        uint32_t upCount;
+        uint32_t downCount;
+        uint32_t padding;
+    };
+
+    //a witness search gives up after settling this many nodes; a witness it
+    //misses only costs an unneeded shortcut, never a wrong route.  Searches
+    //that only estimate a node's priority can stop much sooner.  Neither
+    //follows paths of more than WITNESS_HOP_LIMIT arcs: late in the
+    //contraction the remaining nodes have dozens of long arcs each, and a
+    //witness is nearly always a few of those, so the hop limit keeps the
+    //searches small enough to afford a settle limit that rarely gives up.
+    const int WITNESS_SETTLE_LIMIT = 2000;
+    const int SIMULATED_SETTLE_LIMIT = 30;
+    const int WITNESS_HOP_LIMIT = 8;
+
+    const double INFINITE_DISTANCE = numeric_limits<double>::infinity();
+
+    template<typename T>
+    void writeArray(ofstream& out, const vector<T>& v)
+    {
+        if (!v.empty())
+            out.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+    }
+
+    template<typename T>
+    bool readArray(ifstream& in, vector<T>& v, size_t count)
+    {
+        v.resize(count);
+        if (count != 0)
+            in.read(reinterpret_cast<char*>(v.data()), count * sizeof(T));
+        return static_cast<bool>(in);
+    }
+
+    void removeArc(vector<int>& arcs, int arc)
+    {
+        for (size_t i = 0; i < arcs.size(); i++)
+        {
+            if (arcs[i] == arc)
+            {
+                arcs[i] = arcs.back();
+                arcs.pop_back();
+                return;
+            }
+        }
+    }
+
+    //flattens per node lists of arc IDs into offsets and one array
+    void flatten(const vector<vector<int>>& lists, vector<int>& offset, vector<int>& arcs)
+    {
+        offset.assign(lists.size() + 1, 0);
+        for (size_t v = 0; v < lists.size(); v++)
+            offset[v + 1] = offset[v] + static_cast<int>(lists[v].size());
+        arcs.clear();
+        arcs.reserve(offset.back());
+        for (size_t v = 0; v < lists.size(); v++)
+            arcs.insert(arcs.end(), lists[v].begin(), lists[v].end());
+    }
+
+    // Contracts the nodes of a graph, appending shortcuts to the arc arrays
+    // it is given.  While it runs, out[v] and in[v] hold the arcs between v
+    // and the nodes not yet contracted.
+    class Contractor
+    {
+    public:
+        Contractor(vector<int>& arcFrom, vector<int>& arcTo, vector<int>& arcFirst,
+                   vector<int>& arcSecond, vector<double>& arcLength)
+         : m_arcFrom(arcFrom), m_arcTo(arcTo), m_arcFirst(arcFirst),
+           m_arcSecond(arcSecond), m_arcLength(arcLength)
+        {}
+
+        void run(const StreetGraph& graph, vector<int>& rank,
+                 vector<vector<int>>& up, vector<vector<int>>& down);
+          // witness searches run() stopped at WITNESS_SETTLE_LIMIT
+        int witnessGiveUps() const { return m_giveUps; }
+
+    private:
+        struct Shortcut
+        {
+            int from;
+            int to;
+            double length;
+            int first;
+            int second;
+        };
+
+        vector<int>& m_arcFrom;
+        vector<int>& m_arcTo;
+        vector<int>& m_arcFirst;
+        vector<int>& m_arcSecond;
+        vector<double>& m_arcLength;
+
+        vector<vector<int>> m_out;
+        vector<vector<int>> m_in;
+        vector<int> m_contractedNeighbors;
+        vector<int> m_level;     //one more than the highest contracted neighbor's
+        vector<double> m_priority; //of each node's current queue entry
+        vector<int> m_neighbors; //of the node being contracted
+        int m_giveUps;
+
+        //witness search state; only the touched entries of m_dist are reset
+        IndexedHeap m_heap;
+        vector<double> m_dist;
+        vector<int> m_hops; //arcs on the path to each node m_dist holds
+        vector<int> m_touched;
+        vector<char> m_isTarget;
+        vector<Shortcut> m_shortcuts;
+
+        void addArc(int from, int to, double length, int first, int second);
+        bool witnessSearch(int source, int skip, double maxDistance, int targets, int settleLimit);
+        int contract(int v, bool simulate);
+        double priority(int v);
+    };
+
+    void Contractor::addArc(int from, int to, double length, int first, int second)
+    {
+        //keep only the shortest arc between two nodes
+        vector<int>& out = m_out[from];
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            int a = out[i];
+            if (m_arcTo[a] != to)
+                continue;
+            if (m_arcLength[a] <= length)
+                return;
+            //the old arc stays in the arrays, since shortcuts may be made of it
+            out[i] = out.back();
+            out.pop_back();
+            removeArc(m_in[to], a);
+            break;
+        }
+        int arc = static_cast<int>(m_arcFrom.size());
+        m_arcFrom.push_back(from);
+        m_arcTo.push_back(to);
+        m_arcFirst.push_back(first);
+        m_arcSecond.push_back(second);
+        m_arcLength.push_back(length);
+        out.push_back(arc);
+        m_in[to].push_back(arc);
+    }
+
+    bool Contractor::witnessSearch(int source, int skip, double maxDistance, int targets, int settleLimit)
+    {
+        //Dijkstra over the remaining nodes, leaving out the one being contracted,
+        //until every target's distance is final; returns false if it gave up first
+        m_dist[source] = 0;
+        m_hops[source] = 0;
+        m_touched.push_back(source);
+        m_heap.pushOrDecrease(source, 0);
+        int settled = 0;
+        while (!m_heap.empty() && m_heap.topKey() <= maxDistance && settled < settleLimit)
+        {
+            int u = m_heap.pop();
+            settled++;
+            if (m_isTarget[u] && --targets == 0)
+                return true;
+            if (m_hops[u] == WITNESS_HOP_LIMIT)
+                continue;
+            for (int a : m_out[u])
+            {
+                int w = m_arcTo[a];
+                if (w == skip)
+                    continue;
+                double d = m_dist[u] + m_arcLength[a];
+                if (d < m_dist[w] && d <= maxDistance)
+                {
+                    if (m_dist[w] == INFINITE_DISTANCE)
+                        m_touched.push_back(w);
+                    m_dist[w] = d;
+                    m_hops[w] = m_hops[u] + 1;
+                    m_heap.pushOrDecrease(w, d);
+                }
+            }
+        }
+        return settled < settleLimit;
+    }
+
+    int Contractor::contract(int v, bool simulate)
+    {
+        //a path u->v->w needs a shortcut unless some path avoiding v is as short
+        int count = 0;
+        m_shortcuts.clear();
+        for (int out : m_out[v])
+            m_isTarget[m_arcTo[out]] = 1;
+        for (int in : m_in[v])
+        {
+            int u = m_arcFrom[in];
+            double maxDistance = -1;
+            int targets = 0;
+            for (int out : m_out[v])
+            {
+                if (m_arcTo[out] != u)
+                {
+                    maxDistance = max(maxDistance, m_arcLength[in] + m_arcLength[out]);
+                    targets++;
+                }
+            }
+            if (targets == 0)
+                continue;
+            //u itself is settled first, and is not one of the targets counted
+            if (!witnessSearch(u, v, maxDistance, m_isTarget[u] ? targets + 1 : targets,
+                               simulate ? SIMULATED_SETTLE_LIMIT : WITNESS_SETTLE_LIMIT) && !simulate)
+                m_giveUps++;
+            for (int out : m_out[v])
+            {
+                int w = m_arcTo[out];
+                double length = m_arcLength[in] + m_arcLength[out];
+                if (w == u || m_dist[w] <= length)
+                    continue;
+                count++;
+                if (!simulate)
+                {
+                    Shortcut s = { u, w, length, in, out };
+                    m_shortcuts.push_back(s);
+                }
+            }
+            m_heap.clear();
+            for (int x : m_touched)
+                m_dist[x] = INFINITE_DISTANCE;
+            m_touched.clear();
+        }
+        for (int out : m_out[v])
+            m_isTarget[m_arcTo[out]] = 0;
+        //added once all the witness searches are done, so none of them uses one
+        for (const Shortcut& s : m_shortcuts)
+            addArc(s.from, s.to, s.length, s.first, s.second);
+        return count;
+    }
+
+    double Contractor::priority(int v)
+    {
+        //twice the edge difference (shortcuts added less arcs removed), plus
+        //the contracted neighbors, which spreads contraction evenly over the
+        //map, plus the level, which keeps the hierarchy shallow
+        int arcs = static_cast<int>(m_in[v].size() + m_out[v].size());
+        return 2 * (contract(v, true) - arcs) + m_contractedNeighbors[v] + m_level[v];
+    }
+
+    void Contractor::run(const StreetGraph& graph, vector<int>& rank,
+                         vector<vector<int>>& up, vector<vector<int>>& down)
+    {
+        int n = graph.nodeCount();
+        m_out.assign(n, vector<int>());
+        m_in.assign(n, vector<int>());
+        m_contractedNeighbors.assign(n, 0);
+        m_level.assign(n, 0);
+        m_priority.assign(n, 0);
+        m_giveUps = 0;
+        m_heap.resize(n);
+        m_dist.assign(n, INFINITE_DISTANCE);
+        m_hops.assign(n, 0);
+        m_touched.clear();
+        m_isTarget.assign(n, 0);
+        for (int e = 0; e < graph.edgeCount(); e++)
+        {
+            if (graph.edgeSource(e) != graph.edgeTarget(e))
+                addArc(graph.edgeSource(e), graph.edgeTarget(e), graph.baseEdgeLength(e), e, -1);
+        }
+
+        //least important node first.  Contracting a node changes its
+        //neighbors' priorities, so those are recomputed straight away and
+        //queued again; m_priority tells a node's current entry from the stale
+        //ones.  Shortcuts added elsewhere can still change what a witness
+        //search finds, so as a backstop a node's priority is recomputed once
+        //more when it reaches the top, and it goes back in the queue if it is
+        //no longer the smallest.
+        typedef pair<double, int> Entry;
+        priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+        for (int v = 0; v < n; v++)
+        {
+            m_priority[v] = priority(v);
+            queue.push(Entry(m_priority[v], v));
+        }
+        rank.assign(n, -1);
+        up.assign(n, vector<int>());
+        down.assign(n, vector<int>());
+        int order = 0;
+        while (!queue.empty())
+        {
+            Entry top = queue.top();
+            queue.pop();
+            int v = top.second;
+            if (rank[v] >= 0 || top.first != m_priority[v])
+                continue;
+            double p = priority(v);
+            if (p > top.first && !queue.empty() && p > queue.top().first)
+            {
+                m_priority[v] = p;
+                queue.push(Entry(p, v));
+                continue;
+            }
+
+            //every arc still attached to v leads to a node ranked above it
+            rank[v] = order++;
+            up[v] = m_out[v];
+            down[v] = m_in[v];
+            contract(v, false);
+            m_neighbors.clear();
+            for (int a : m_in[v])
+            {
+                removeArc(m_out[m_arcFrom[a]], a);
+                m_neighbors.push_back(m_arcFrom[a]);
+            }
+            for (int a : m_out[v])
+            {
+                removeArc(m_in[m_arcTo[a]], a);
+                m_neighbors.push_back(m_arcTo[a]);
+            }
+            m_out[v].clear();
+            m_in[v].clear();
+            //a two-way street is two arcs, but one neighbor
+            sort(m_neighbors.begin(), m_neighbors.end());
+            m_neighbors.erase(unique(m_neighbors.begin(), m_neighbors.end()), m_neighbors.end());
+            for (int u : m_neighbors)
+            {
+                m_contractedNeighbors[u]++;
+                m_level[u] = max(m_level[u], m_level[v] + 1);
+                m_priority[u] = priority(u);
+                queue.push(Entry(m_priority[u], u));
+            }
+        }
+    }
+
+    // Search state for one query.  Each thread keeps its own, so queries
+    // don't allocate or clear arrays sized to the map.
+    struct QueryWorkspace
+    {
+        IndexedHeap heap[2];
+        vector<double> dist[2];
+        vector<int> parentArc[2];
+        vector<int> touched;
+        vector<int> arcs;  //the route found, before unpacking
+        vector<int> stack; //for unpacking
+
+        void prepare(int n)
+        {
+            if (static_cast<int>(dist[0].size()) == n)
+                return;
+            for (int side = 0; side < 2; side++)
+            {
+                heap[side].resize(n);
+                dist[side].assign(n, INFINITE_DISTANCE);
+                parentArc[side].assign(n, -1);
+            }
+            touched.clear();
+        }
+
+        void reset()
+        {
+            for (int v : touched)
+            {
+                dist[0][v] = INFINITE_DISTANCE;
+                dist[1][v] = INFINITE_DISTANCE;
+            }
+            touched.clear();
+            heap[0].clear();
+            heap[1].clear();
+        }
+    };
+}
+
+ContractionHierarchy::ContractionHierarchy()
+ : m_fingerprint(0), m_edgeCount(0)
+{
+}
+
+void ContractionHierarchy::clear()
+{
+    m_fingerprint = 0;
+    m_edgeCount = 0;
+    m_rank.clear();
+    m_arcFrom.clear();
+    m_arcTo.clear();
+    m_arcFirst.clear();
+    m_arcSecond.clear();
+    m_arcLength.clear();
+    m_upOffset.clear();
+    m_upArcs.clear();
+    m_downOffset.clear();
+    m_downArcs.clear();
+    m_stats = HierarchyStats();
+}
+
+void ContractionHierarchy::build(const StreetGraph& graph)
+{
+    auto startTime = chrono::steady_clock::now();
+    clear();
+    vector<vector<int>> up;
+    vector<vector<int>> down;
+    Contractor contractor(m_arcFrom, m_arcTo, m_arcFirst, m_arcSecond, m_arcLength);
+    contractor.run(graph, m_rank, up, down);
+    flatten(up, m_upOffset, m_upArcs);
+    flatten(down, m_downOffset, m_downArcs);
+    m_fingerprint = graph.fingerprint();
+    m_edgeCount = graph.edgeCount();
+    computeStats();
+    m_stats.witnessGiveUps = contractor.witnessGiveUps();
+    m_stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+bool ContractionHierarchy::load(const string& file, const StreetGraph& graph)
+{
+    auto startTime = chrono::steady_clock::now();
+    clear();
+    ifstream in(file, ios::binary);
+    if (!in)
+        return false;
+    HierarchyHeader h;
+    if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) ||
+        memcmp(h.magic, HIERARCHY_MAGIC, sizeof(h.magic)) != 0 ||
+        h.version != HIERARCHY_VERSION || h.byteOrder != BYTE_ORDER_MARK ||
+        h.fingerprint != graph.fingerprint() ||
+        h.nodeCount != static_cast<uint32_t>(graph.nodeCount()) ||
+        h.edgeCount != static_cast<uint32_t>(graph.edgeCount()))
+        return false;
+
+    int n = h.nodeCount;
+    bool ok = readArray(in, m_rank, n) &&
+        readArray(in, m_arcFrom, h.arcCount) && readArray(in, m_arcTo, h.arcCount) &&
+        readArray(in, m_arcFirst, h.arcCount) && readArray(in, m_arcSecond, h.arcCount) &&
+        readArray(in, m_arcLength, h.arcCount) &&
+        readArray(in, m_upOffset, n + 1) && readArray(in, m_upArcs, h.upCount) &&
+        readArray(in, m_downOffset, n + 1) && readArray(in, m_downArcs, h.downCount);
+
+    //check every index a query follows, so a damaged file can't send one astray;
+    //shortcuts only refer to earlier arcs, so unpacking always ends
+    int arcCount = h.arcCount;
+    for (int a = 0; ok && a < arcCount; a++)
+    {
+        ok = m_arcFrom[a] >= 0 && m_arcFrom[a] < n && m_arcTo[a] >= 0 && m_arcTo[a] < n;
+        if (m_arcSecond[a] < 0)
+            ok = ok && m_arcFirst[a] >= 0 && m_arcFirst[a] < graph.edgeCount();
+        else
+            ok = ok && m_arcFirst[a] >= 0 && m_arcFirst[a] < a && m_arcSecond[a] < a;
+    }
+    ok = ok && m_upOffset[0] == 0 && m_upOffset[n] == static_cast<int>(h.upCount) &&
+         m_downOffset[0] == 0 && m_downOffset[n] == static_cast<int>(h.downCount);
+    for (int v = 0; ok && v < n; v++)
+        ok = m_upOffset[v] <= m_upOffset[v + 1] && m_downOffset[v] <= m_downOffset[v + 1];
+    for (size_t i = 0; ok && i < m_upArcs.size(); i++)
+        ok = m_upArcs[i] >= 0 && m_upArcs[i] < arcCount;
+    for (size_t i = 0; ok && i < m_downArcs.size(); i++)
+        ok = m_downArcs[i] >= 0 && m_downArcs[i] < arcCount;
+    if (!ok)
+    {
+        clear();
+        return false;
+    }
+
+    m_fingerprint = h.fingerprint;
+    m_edgeCount = h.edgeCount;
+    computeStats();
+    m_stats.loadedFromFile = true;
+    m_stats.savedToFile = true;
+    m_stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    return true;
+}
+
+bool ContractionHierarchy::save(const string& file)
+{
+    m_stats.savedToFile = write(file);
+    return m_stats.savedToFile;
+}
+
+bool ContractionHierarchy::write(const string& file) const
+{
+    if (empty())
+        return false;
+    HierarchyHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, HIERARCHY_MAGIC, sizeof(h.magic));
+    h.version = HIERARCHY_VERSION;
+    h.byteOrder = BYTE_ORDER_MARK;
+    h.fingerprint = m_fingerprint;
+    h.nodeCount = m_rank.size();
+    h.edgeCount = m_edgeCount;
+    h.arcCount = m_arcFrom.size();
+    h.upCount = m_upArcs.size();
+    h.downCount = m_downArcs.size();
+
+    //write beside the target and rename, like StreetGraph::saveSnapshot
+    string tempFile = file + ".tmp";
+    {
+        ofstream out(tempFile, ios::binary | ios::trunc);
+        if (!out)
+            return false;
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        writeArray(out, m_rank);
+        writeArray(out, m_arcFrom);
+        writeArray(out, m_arcTo);
+        writeArray(out, m_arcFirst);
+        writeArray(out, m_arcSecond);
+        writeArray(out, m_arcLength);
+        writeArray(out, m_upOffset);
+        writeArray(out, m_upArcs);
+        writeArray(out, m_downOffset);
+        writeArray(out, m_downArcs);
+        if (!out)
+        {
+            out.close();
+            remove(tempFile.c_str());
+            return false;
+        }
+    }
+    if (rename(tempFile.c_str(), file.c_str()) != 0)
+    {
+        remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+void ContractionHierarchy::computeStats()
+{
+    int arcCount = static_cast<int>(m_arcFrom.size());
+    int shortcuts = 0;
+    for (int a = 0; a < arcCount; a++)
+    {
+        if (m_arcSecond[a] >= 0)
+            shortcuts++;
+    }
+    //per arc: from, to, first, second, length, and one entry in an up or down list
+    const double arcBytes = 4 * sizeof(int) + sizeof(double) + sizeof(int);
+    double bytes = arcCount * arcBytes +
+        (m_rank.size() + m_upOffset.size() + m_downOffset.size()) * sizeof(int);
+    m_stats.nodes = static_cast<int>(m_rank.size());
+    m_stats.edges = arcCount - shortcuts;
+    m_stats.shortcuts = shortcuts;
+    m_stats.megabytes = bytes / 1e6;
+    m_stats.shortcutMegabytes = shortcuts * arcBytes / 1e6;
+}
+
+bool ContractionHierarchy::findPath(int source, int target, vector<int>& path, RouteStats& stats) const
+{
+    static thread_local QueryWorkspace ws;
+    ws.prepare(static_cast<int>(m_rank.size()));
+
+    //side 0 searches up from the start, side 1 searches up from the end over
+    //reversed arcs; a side stops once its smallest key can't beat the best
+    //start-to-end distance found so far
+    double best = INFINITE_DISTANCE;
+    int meeting = -1;
+    ws.dist[0][source] = 0;
+    ws.dist[1][target] = 0;
+    ws.touched.push_back(source);
+    ws.touched.push_back(target);
+    ws.heap[0].pushOrDecrease(source, 0);
+    ws.heap[1].pushOrDecrease(target, 0);
+    if (source == target)
+    {
+        best = 0;
+        meeting = source;
+    }
+
+    for (;;)
+    {
+        bool forward = !ws.heap[0].empty() && ws.heap[0].topKey() < best;
+        bool backward = !ws.heap[1].empty() && ws.heap[1].topKey() < best;
+        if (!forward && !backward)
+            break;
+        int side = forward && (!backward || ws.heap[0].topKey() <= ws.heap[1].topKey()) ? 0 : 1;
+        int v = ws.heap[side].pop();
+        stats.nodesSettled++;
+
+        //stall on demand: if a higher node reaches v more cheaply over one of
+        //v's arcs in the other direction, v's distance here is too long and no
+        //shortest path continues upward through it
+        const int* other = side == 0 ? m_downArcs.data() + m_downOffset[v] : m_upArcs.data() + m_upOffset[v];
+        const int* otherEnd = side == 0 ? m_downArcs.data() + m_downOffset[v + 1] : m_upArcs.data() + m_upOffset[v + 1];
+        bool stalled = false;
+        for (const int* p = other; p != otherEnd && !stalled; p++)
+        {
+            int x = side == 0 ? m_arcFrom[*p] : m_arcTo[*p];
+            stalled = ws.dist[side][x] + m_arcLength[*p] < ws.dist[side][v];
+        }
+        if (stalled)
+            continue;
+
+        const int* first = side == 0 ? m_upArcs.data() + m_upOffset[v] : m_downArcs.data() + m_downOffset[v];
+        const int* last = side == 0 ? m_upArcs.data() + m_upOffset[v + 1] : m_downArcs.data() + m_downOffset[v + 1];
+        for (const int* p = first; p != last; p++)
+        {
+            int a = *p;
+            int x = side == 0 ? m_arcTo[a] : m_arcFrom[a];
+            stats.edgesRelaxed++;
+            double d = ws.dist[side][v] + m_arcLength[a];
+            if (!(d < ws.dist[side][x]))
+                continue;
+            if (ws.dist[0][x] == INFINITE_DISTANCE && ws.dist[1][x] == INFINITE_DISTANCE)
+                ws.touched.push_back(x);
+            ws.dist[side][x] = d;
+            ws.parentArc[side][x] = a;
+            ws.heap[side].pushOrDecrease(x, d);
+            //a node reached from both sides joins a start-to-end path
+            if (d + ws.dist[1 - side][x] < best)
+            {
+                best = d + ws.dist[1 - side][x];
+                meeting = x;
+            }
+        }
+    }
+
+    if (meeting >= 0)
+    {
+        //arcs from the start up to the meeting node, then down to the end
+        vector<int>& arcs = ws.arcs;
+        arcs.clear();
+        for (int v = meeting; v != source; v = m_arcFrom[ws.parentArc[0][v]])
+            arcs.push_back(ws.parentArc[0][v]);
+        reverse(arcs.begin(), arcs.end());
+        for (int v = meeting; v != target; v = m_arcTo[ws.parentArc[1][v]])
+            arcs.push_back(ws.parentArc[1][v]);
+        unpack(arcs, ws.stack, path);
+    }
+    ws.reset();
+    return meeting >= 0;
+}
+
+void ContractionHierarchy::unpack(const vector<int>& arcs, vector<int>& stack, vector<int>& path) const
+{
+    //shortcuts nest as deep as the hierarchy, so use an explicit stack
+    //instead of recursion; the last arc is pushed first so the first pops first
+    stack.assign(arcs.rbegin(), arcs.rend());
+    while (!stack.empty())
+    {
+        int a = stack.back();
+        stack.pop_back();
+        if (m_arcSecond[a] < 0)
+            path.push_back(m_arcFirst[a]);
+        else
+        {
+            stack.push_back(m_arcSecond[a]);
+            stack.push_back(m_arcFirst[a]);
+        }
+    }
+}
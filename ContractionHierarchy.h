@@ -0,0 +1,82 @@
+// ContractionHierarchy.h
+
+// Contraction hierarchy over a StreetGraph.  Preprocessing removes the nodes
+// one at a time, least important first, and adds a shortcut arc u->w whenever
+// removing v would lose the only shortest path u->v->w.  A query then only
+// ever needs to move to more important nodes: a forward search from the start
+// over upward arcs and a backward search from the end over downward arcs meet
+// at the most important node of the shortest path, after settling a few
+// hundred nodes even on a large map.
+//
+// Every arc is either a graph edge or a shortcut made of two earlier arcs, so
+// a path of arcs unpacks into the graph edges it stands for.
+//
+// The hierarchy is built on the map's base edge lengths, so live changes to
+// the lengths don't invalidate it; see StreetGraph.h for when its paths are
+// still shortest.
+
+#ifndef CONTRACTIONHIERARCHY_INCLUDED
+#define CONTRACTIONHIERARCHY_INCLUDED
+
+#include "provided.h"
+#include "StreetGraph.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ContractionHierarchy
+{
+public:
+    ContractionHierarchy();
+    void clear();
+    bool empty() const { return m_rank.empty(); }
+
+      // contracts every node of graph; replaces the current hierarchy
+    void build(const StreetGraph& graph);
+
+      // reads a hierarchy written by save; returns false (leaving the hierarchy
+      // empty) if the file is missing or corrupt or was built for another map
+    bool load(const std::string& file, const StreetGraph& graph);
+      // also records in stats() whether it succeeded
+    bool save(const std::string& file);
+
+      // fills path with the graph edges of a shortest path (by base length)
+      // from source to target, in order; returns false if there is none
+    bool findPath(int source, int target, std::vector<int>& path, RouteStats& stats) const;
+
+    const HierarchyStats& stats() const { return m_stats; }
+
+      // C++11 syntax for preventing copying and assignment
+    ContractionHierarchy(const ContractionHierarchy&) = delete;
+    ContractionHierarchy& operator=(const ContractionHierarchy&) = delete;
+
+private:
+    std::uint64_t m_fingerprint; //StreetGraph::fingerprint of the map it was built for
+    int m_edgeCount;
+    std::vector<int> m_rank; //contraction order of each node
+
+    //arcs: a graph edge has m_arcFirst = the edge ID and m_arcSecond = -1;
+    //a shortcut has the IDs of the two arcs it replaces, both smaller than its own
+    std::vector<int> m_arcFrom;
+    std::vector<int> m_arcTo;
+    std::vector<int> m_arcFirst;
+    std::vector<int> m_arcSecond;
+    std::vector<double> m_arcLength;
+
+    //arcs leaving each node for a higher ranked one, and arcs entering each
+    //node from a higher ranked one, as runs of arc IDs
+    std::vector<int> m_upOffset;
+    std::vector<int> m_upArcs;
+    std::vector<int> m_downOffset;
+    std::vector<int> m_downArcs;
+
+    HierarchyStats m_stats;
+
+    void computeStats();
+    bool write(const std::string& file) const;
+      // appends the graph edges behind a run of arcs to path, using stack as
+      // scratch space
+    void unpack(const std::vector<int>& arcs, std::vector<int>& stack, std::vector<int>& path) const;
+};
+
+#endif // CONTRACTIONHIERARCHY_INCLUDED
@@ -0,0 +1,230 @@
+#include "provided.h"
+#include "CrowPoints.h"
+#include "StreetGraph.h"
+#include <cmath>
+#include <vector>
+#if defined(__AVX512F__) || defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const double HALF_PI = 1.5707963267948966;
+
+    //Taylor series of asin(r) / r in powers of r*r, through r^14; past r = 1/2
+    //the terms left out add up to under 1.2e-7 of r
+    const double ASIN_SERIES[] = {
+        1.0, 1.0 / 6, 3.0 / 40, 15.0 / 336, 105.0 / 3456, 945.0 / 42240,
+        10395.0 / 599040, 135135.0 / 9676800
+    };
+    const int ASIN_TERMS = sizeof(ASIN_SERIES) / sizeof(ASIN_SERIES[0]);
+
+    // One double at a time, for the points left over after the last full
+    // vector, and for everything when no vector instructions are available.
+    struct ScalarLanes
+    {
+        typedef double V;
+        static const int WIDTH = 1;
+        static V load(const double* p) { return *p; }
+        static void store(double* p, V v) { *p = v; }
+        static V set(double x) { return x; }
+        static V add(V a, V b) { return a + b; }
+        static V sub(V a, V b) { return a - b; }
+        static V mul(V a, V b) { return a * b; }
+        static V sqrt(V a) { return std::sqrt(a); }
+        static V min(V a, V b) { return a < b ? a : b; }
+        //then in the lanes where a > b, otherwise in the rest
+        static V ifGreater(V a, V b, V then, V otherwise) { return a > b ? then : otherwise; }
+    };
+
+#if defined(__AVX512F__)
+    const char* const KERNEL = "AVX-512";
+    const bool POLYNOMIAL_ASIN = true;
+    struct VectorLanes
+    {
+        typedef __m512d V;
+        static const int WIDTH = 8;
+        static V load(const double* p) { return _mm512_loadu_pd(p); }
+        static void store(double* p, V v) { _mm512_storeu_pd(p, v); }
+        static V set(double x) { return _mm512_set1_pd(x); }
+        static V add(V a, V b) { return _mm512_add_pd(a, b); }
+        static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+        static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+        static V sqrt(V a) { return _mm512_sqrt_pd(a); }
+        static V min(V a, V b) { return _mm512_min_pd(a, b); }
+        static V ifGreater(V a, V b, V then, V otherwise)
+        {
+            return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_GT_OQ), otherwise, then);
+        }
+    };
+#elif defined(__AVX__)
+    const char* const KERNEL = "AVX";
+    const bool POLYNOMIAL_ASIN = true;
+    struct VectorLanes
+    {
+        typedef __m256d V;
+        static const int WIDTH = 4;
+        static V load(const double* p) { return _mm256_loadu_pd(p); }
+        static void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+        static V set(double x) { return _mm256_set1_pd(x); }
+        static V add(V a, V b) { return _mm256_add_pd(a, b); }
+        static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+        static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+        static V sqrt(V a) { return _mm256_sqrt_pd(a); }
+        static V min(V a, V b) { return _mm256_min_pd(a, b); }
+        static V ifGreater(V a, V b, V then, V otherwise)
+        {
+            return _mm256_blendv_pd(otherwise, then, _mm256_cmp_pd(a, b, _CMP_GT_OQ));
+        }
+    };
+#elif defined(__SSE2__)
+    const char* const KERNEL = "SSE2";
+    //two lanes don't win back the polynomial's extra work over std::asin
+    const bool POLYNOMIAL_ASIN = false;
+    struct VectorLanes
+    {
+        typedef __m128d V;
+        static const int WIDTH = 2;
+        static V load(const double* p) { return _mm_loadu_pd(p); }
+        static void store(double* p, V v) { _mm_storeu_pd(p, v); }
+        static V set(double x) { return _mm_set1_pd(x); }
+        static V add(V a, V b) { return _mm_add_pd(a, b); }
+        static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+        static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+        static V sqrt(V a) { return _mm_sqrt_pd(a); }
+        static V min(V a, V b) { return _mm_min_pd(a, b); }
+        static V ifGreater(V a, V b, V then, V otherwise)
+        {
+            V mask = _mm_cmpgt_pd(a, b);
+            return _mm_or_pd(_mm_and_pd(mask, then), _mm_andnot_pd(mask, otherwise));
+        }
+    };
+#else
+    const char* const KERNEL = "scalar";
+    const bool POLYNOMIAL_ASIN = false;
+    typedef ScalarLanes VectorLanes;
+#endif
+
+    //arcsine of x in [0, 1]: the series converges fast enough up to 1/2, and
+    //above that asin(x) = pi/2 - 2 asin(sqrt((1 - x) / 2)) brings the
+    //argument back under 1/2
+    template<typename L>
+    typename L::V polynomialAsin(typename L::V x)
+    {
+        typedef typename L::V V;
+        V half = L::set(0.5);
+        V r = L::ifGreater(x, half, L::sqrt(L::mul(L::sub(L::set(1), x), half)), x);
+        V r2 = L::mul(r, r);
+        V p = L::set(ASIN_SERIES[ASIN_TERMS - 1]);
+        for (int k = ASIN_TERMS - 2; k >= 0; k--)
+            p = L::add(L::mul(p, r2), L::set(ASIN_SERIES[k]));
+        p = L::mul(p, r);
+        return L::ifGreater(x, half, L::sub(L::set(HALF_PI), L::add(p, p)), p);
+    }
+
+    //for the points [first, last), writes half the chord from (px, py, pz)
+    //to each, or if approximate the miles to each; returns where it stopped,
+    //which is short of last by less than one vector
+    template<typename L>
+    int crowKernel(const double p[3], const double* x, const double* y, const double* z,
+                   int first, int last, double* out, bool approximate)
+    {
+        typedef typename L::V V;
+        V px = L::set(p[0]);
+        V py = L::set(p[1]);
+        V pz = L::set(p[2]);
+        int i = first;
+        for (; i + L::WIDTH <= last; i += L::WIDTH)
+        {
+            V dx = L::sub(L::load(x + i), px);
+            V dy = L::sub(L::load(y + i), py);
+            V dz = L::sub(L::load(z + i), pz);
+            V chordSquared = L::add(L::add(L::mul(dx, dx), L::mul(dy, dy)), L::mul(dz, dz));
+            //rounding can put opposite points a hair more than 2 apart
+            V h = L::min(L::mul(L::sqrt(chordSquared), L::set(0.5)), L::set(1));
+            if (approximate)
+                h = L::mul(polynomialAsin<L>(h), L::set(2 * EARTH_RADIUS_MILES));
+            L::store(out + i, h);
+        }
+        return i;
+    }
+}
+
+// measured over random pairs anywhere on the globe; the worst is for pairs
+// just over 60 degrees apart, where the series is taken furthest
+const double CrowPoints::APPROXIMATE_RELATIVE_ERROR = 5e-7;
+
+const char* CrowPoints::kernel()
+{
+    return KERNEL;
+}
+
+bool CrowPoints::polynomialAsin()
+{
+    return POLYNOMIAL_ASIN;
+}
+
+CrowPoints::CrowPoints()
+{
+}
+
+void CrowPoints::clear()
+{
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+}
+
+void CrowPoints::assign(const vector<GeoCoord>& points)
+{
+    m_x.resize(points.size());
+    m_y.resize(points.size());
+    m_z.resize(points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        double v[3];
+        unitVector(points[i].latitude, points[i].longitude, v);
+        m_x[i] = v[0];
+        m_y[i] = v[1];
+        m_z[i] = v[2];
+    }
+}
+
+void CrowPoints::assign(const StreetGraph& graph)
+{
+    int n = graph.nodeCount();
+    m_x.resize(n);
+    m_y.resize(n);
+    m_z.resize(n);
+    for (int v = 0; v < n; v++)
+    {
+        const double* u = graph.unitVector(v);
+        m_x[v] = u[0];
+        m_y[v] = u[1];
+        m_z[v] = u[2];
+    }
+}
+
+void CrowPoints::oneToMany(int from, const CrowPoints& to, double* miles, Accuracy accuracy) const
+{
+    const double p[3] = { m_x[from], m_y[from], m_z[from] };
+    int n = to.size();
+    bool approximate = accuracy == APPROXIMATE && POLYNOMIAL_ASIN;
+    int done = crowKernel<VectorLanes>(p, to.m_x.data(), to.m_y.data(), to.m_z.data(), 0, n, miles, approximate);
+    crowKernel<ScalarLanes>(p, to.m_x.data(), to.m_y.data(), to.m_z.data(), done, n, miles, approximate);
+    if (!approximate)
+    {
+        for (int i = 0; i < n; i++)
+            miles[i] = 2 * EARTH_RADIUS_MILES * asin(miles[i]);
+    }
+}
+
+void CrowPoints::manyToMany(const CrowPoints& to, double* miles, Accuracy accuracy) const
+{
+    for (int i = 0; i < size(); i++)
+        oneToMany(i, to, miles + static_cast<size_t>(i) * to.size(), accuracy);
+}
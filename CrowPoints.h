@@ -0,0 +1,75 @@
+// CrowPoints.h
+
+// Crow-fly distances in bulk: from one point to many, or between every pair
+// of two sets.  Each point is converted once into a unit vector from the
+// center of the Earth, stored as three arrays (x, y and z), so a distance
+// needs no trigonometry on the coordinates.  The chord c between two unit
+// vectors is what the haversine formula works out (its haversine term is
+// c*c/4), and the distance is 2R asin(c/2).  The chords are computed several
+// at a time with AVX-512, AVX or SSE2 instructions, whichever the compiler
+// targets (plain code otherwise).  APPROXIMATE mode also computes the
+// arcsines that way, with a polynomial in place of std::asin, but only with
+// AVX or AVX-512: with two lanes or fewer the polynomial is slower than
+// std::asin on map-sized distances, so it falls back to EXACT.
+//
+// EXACT distances agree with distanceEarthMiles to within rounding: about a
+// part in 10^11 of the distance for points a few yards apart, far less for
+// points farther apart.  APPROXIMATE ones are off by at most
+// APPROXIMATE_RELATIVE_ERROR of the distance.
+
+#ifndef CROWPOINTS_INCLUDED
+#define CROWPOINTS_INCLUDED
+
+#include "provided.h"
+#include <cmath>
+#include <vector>
+
+class StreetGraph;
+
+// Mean radius of the Earth, as distanceEarthMiles takes it.
+const double EARTH_RADIUS_MILES = 6371.0 / 1.609344;
+
+// The unit vector pointing at a coordinate pair from the center of the Earth.
+inline void unitVector(double latitude, double longitude, double v[3])
+{
+    double lat = deg2rad(latitude);
+    double lon = deg2rad(longitude);
+    v[0] = std::cos(lat) * std::cos(lon);
+    v[1] = std::cos(lat) * std::sin(lon);
+    v[2] = std::sin(lat);
+}
+
+class CrowPoints
+{
+public:
+    enum Accuracy { EXACT, APPROXIMATE };
+    static const double APPROXIMATE_RELATIVE_ERROR;
+
+      // the instruction set the distances are computed with: "AVX-512",
+      // "AVX", "SSE2" or "scalar"; the default build gets "SSE2"
+    static const char* kernel();
+      // whether APPROXIMATE computes anything differently from EXACT in
+      // this build
+    static bool polynomialAsin();
+
+    CrowPoints();
+    void clear();
+    void assign(const std::vector<GeoCoord>& points);
+      // every node of graph, in node ID order
+    void assign(const StreetGraph& graph);
+    int size() const { return static_cast<int>(m_x.size()); }
+
+      // miles from point from to each point of to, written to miles[0] to
+      // miles[to.size() - 1]
+    void oneToMany(int from, const CrowPoints& to, double* miles, Accuracy accuracy = EXACT) const;
+      // miles from each point to each point of to, row-major: a row of
+      // to.size() distances per point
+    void manyToMany(const CrowPoints& to, double* miles, Accuracy accuracy = EXACT) const;
+
+private:
+    std::vector<double> m_x;
+    std::vector<double> m_y;
+    std::vector<double> m_z;
+};
+
+#endif // CROWPOINTS_INCLUDED
@@ -1,10 +1,380 @@
 #include "provided.h"
+#include "DistanceMatrix.h"
+#include "Tour.h"
 #include <vector>
-#include <ctime>
-#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <limits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
+namespace
+{
+    //how many of each stop's nearest stops the local search tries moves toward
+    const int NEIGHBOR_COUNT = 8;
+    //a move must shorten the tour by more than this to count as an improvement
+    const double MIN_GAIN = 1e-9;
+    //times during a run that the chains compare notes and take the best tour
+    const int EXCHANGES = 8;
+    //annealing moves between looks at the clock
+    const int CLOCK_CHECK_INTERVAL = 1024;
+    //largest batch solved exactly, whatever the caller asks: the table is
+    //2^n rows of n distances, 8 MB at 16 stops (and 168 MB at 20), and the
+    //batch planner may be solving one on every core at once
+    const int MAX_EXACT_STOPS = 16;
+
+    // The caller's deadline, if any.  Once any chain sees it pass, the rest
+    // stop at their next look, keeping the best tour they have.
+    class Deadline
+    {
+    public:
+        Deadline(chrono::steady_clock::time_point start, double seconds)
+         : m_start(start), m_seconds(seconds), m_passed(false)
+        {}
+
+        bool passed()
+        {
+            if (m_passed)
+                return true;
+            if (m_seconds > 0 && elapsed() >= m_seconds)
+                m_passed = true;
+            return m_passed;
+        }
+        //whether a look has found it passed
+        bool reached() const { return m_passed; }
+        //fraction of the time used; 0 if there is no deadline
+        double progress() const { return m_seconds > 0 ? min(1.0, elapsed() / m_seconds) : 0; }
+
+    private:
+        chrono::steady_clock::time_point m_start;
+        double m_seconds;
+        atomic<bool> m_passed;
+
+        double elapsed() const { return chrono::duration<double>(chrono::steady_clock::now() - m_start).count(); }
+    };
+
+    // xoshiro256** generator.  Each chain gets its own, seeded from the
+    // caller's seed and the chain's number, so chains never share state and a
+    // seed always replays the same moves.
+    class Random
+    {
+    public:
+        Random(uint64_t seed, uint64_t stream)
+        {
+            //expand (seed, stream) into the 256-bit state with splitmix64
+            uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ULL);
+            for (int i = 0; i < 4; i++)
+            {
+                x += 0x9E3779B97F4A7C15ULL;
+                uint64_t z = x;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                m_state[i] = z ^ (z >> 31);
+            }
+        }
+
+        uint64_t next()
+        {
+            uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+            uint64_t t = m_state[1] << 17;
+            m_state[2] ^= m_state[0];
+            m_state[3] ^= m_state[1];
+            m_state[1] ^= m_state[2];
+            m_state[0] ^= m_state[3];
+            m_state[2] ^= t;
+            m_state[3] = rotl(m_state[3], 45);
+            return result;
+        }
+
+        //uniform in [0, n)
+        int below(int n) { return static_cast<int>((next() >> 32) * static_cast<uint64_t>(n) >> 32); }
+        //uniform in [0, 1)
+        double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    private:
+        uint64_t m_state[4];
+
+        static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+    };
+
+    // One independent search: its own tour, random numbers and best tour so far.
+    struct Chain
+    {
+        Tour tour;
+        Random random;
+        vector<int> best;
+        double bestDis;
+        double startTemperature; //annealing only
+        double temperature;
+        OptimizerStats stats;
+
+        Chain(const DistanceMatrix& matrix, uint64_t seed, int number)
+         : tour(matrix), random(seed, number), bestDis(0), startTemperature(0), temperature(0)
+        {}
+
+        void keepIfBest()
+        {
+            if (best.empty() || tour.length() < bestDis - MIN_GAIN)
+            {
+                best = tour.order();
+                bestDis = tour.length();
+            }
+        }
+    };
+
+    // Threads that run the chains, started once per optimization and kept
+    // for every epoch.  run() hands out one epoch's chains and returns when
+    // they are all done, so it is also the barrier before the chains compare
+    // notes.  The calling thread runs chains too.
+    class ChainWorkers
+    {
+    public:
+        ChainWorkers(int count, unsigned threads)
+         : m_count(count), m_work(nullptr), m_next(0), m_epoch(0), m_busy(0), m_stopping(false)
+        {
+            threads = min(max(1u, threads), static_cast<unsigned>(max(count, 1)));
+            for (unsigned t = 1; t < threads; t++)
+                m_threads.push_back(thread([this]() { serve(); }));
+        }
+
+        ~ChainWorkers()
+        {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_wake.notify_all();
+            for (size_t t = 0; t < m_threads.size(); t++)
+                m_threads[t].join();
+        }
+
+        //calls work(c) for every chain c and waits for all of them
+        void run(const function<void(int)>& work)
+        {
+            {
+                lock_guard<mutex> lock(m_mutex);
+                m_work = &work;
+                m_next = 0;
+                m_busy = static_cast<int>(m_threads.size());
+                m_epoch++;
+            }
+            m_wake.notify_all();
+            runChains();
+            unique_lock<mutex> lock(m_mutex);
+            m_done.wait(lock, [this]() { return m_busy == 0; });
+            m_work = nullptr;
+        }
+
+        // C++11 syntax for preventing copying and assignment
+        ChainWorkers(const ChainWorkers&) = delete;
+        ChainWorkers& operator=(const ChainWorkers&) = delete;
+
+    private:
+        int m_count;
+        const function<void(int)>* m_work;
+        atomic<int> m_next;
+        unsigned m_epoch;
+        int m_busy; //threads still working on this epoch
+        bool m_stopping;
+        mutex m_mutex;
+        condition_variable m_wake;
+        condition_variable m_done;
+        vector<thread> m_threads;
+
+        void runChains()
+        {
+            for (int c = m_next++; c < m_count; c = m_next++)
+                (*m_work)(c);
+        }
+
+        //each thread waits for an epoch, runs chains until none are left,
+        //then reports back
+        void serve()
+        {
+            unsigned seen = 0;
+            for (;;)
+            {
+                {
+                    unique_lock<mutex> lock(m_mutex);
+                    m_wake.wait(lock, [&]() { return m_stopping || m_epoch != seen; });
+                    if (m_stopping)
+                        return;
+                    seen = m_epoch;
+                }
+                runChains();
+                {
+                    lock_guard<mutex> lock(m_mutex);
+                    m_busy--;
+                }
+                m_done.notify_one();
+            }
+        }
+    };
+
+    //each matrix index's nearest stops (never the depot), closest first;
+    //distance counts both ways, since a move may use either leg
+    vector<vector<int>> nearestStops(const DistanceMatrix& matrix)
+    {
+        int n = matrix.size();
+        int k = min(NEIGHBOR_COUNT, n - 2);
+        vector<vector<int>> neighbors(n);
+        vector<pair<double, int>> candidates;
+        for (int a = 0; a < n; a++)
+        {
+            candidates.clear();
+            for (int b = 1; b < n; b++)
+            {
+                if (b != a)
+                    candidates.push_back(make_pair(matrix.distance(a, b) + matrix.distance(b, a), b));
+            }
+            int count = min(k, static_cast<int>(candidates.size()));
+            partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+            for (int i = 0; i < count; i++)
+                neighbors[a].push_back(candidates[i].second);
+        }
+        return neighbors;
+    }
+
+    //greedy tour: from the depot, always drive to the closest stop not yet visited
+    vector<int> nearestNeighborOrder(const DistanceMatrix& matrix)
+    {
+        int n = matrix.size();
+        vector<char> visited(n, 0);
+        vector<int> order;
+        int from = 0;
+        for (int step = 1; step < n; step++)
+        {
+            int next = -1;
+            for (int b = 1; b < n; b++)
+            {
+                if (!visited[b] && (next < 0 || matrix.distance(from, b) < matrix.distance(from, next)))
+                    next = b;
+            }
+            visited[next] = 1;
+            order.push_back(next);
+            from = next;
+        }
+        return order;
+    }
+
+    //smallest of row[k] + add[k] over k in [0, width), width a multiple of 4
+    inline double minSum(const double* row, const double* add, int width)
+    {
+#ifdef __SSE2__
+        __m128d m0 = _mm_set1_pd(numeric_limits<double>::infinity());
+        __m128d m1 = m0;
+        for (int k = 0; k < width; k += 4)
+        {
+            m0 = _mm_min_pd(m0, _mm_add_pd(_mm_loadu_pd(row + k), _mm_loadu_pd(add + k)));
+            m1 = _mm_min_pd(m1, _mm_add_pd(_mm_loadu_pd(row + k + 2), _mm_loadu_pd(add + k + 2)));
+        }
+        m0 = _mm_min_pd(m0, m1);
+        return min(_mm_cvtsd_f64(m0), _mm_cvtsd_f64(_mm_unpackhi_pd(m0, m0)));
+#else
+        double m[4] = { row[0] + add[0], row[1] + add[1], row[2] + add[2], row[3] + add[3] };
+        for (int k = 4; k < width; k += 4)
+        {
+            for (int l = 0; l < 4; l++)
+                m[l] = min(m[l], row[k + l] + add[k + l]);
+        }
+        return min(min(m[0], m[1]), min(m[2], m[3]));
+#endif
+    }
+
+    //the shortest order of every stop, by Held-Karp dynamic programming:
+    //best[S][j] is the shortest drive from the depot through the set S of
+    //stops ending at stop j.  Rows are padded to a multiple of four with
+    //infinity, as are the entries for stops not in S, so each entry is one
+    //branch-free minimum over a contiguous row.
+    vector<int> shortestOrder(const DistanceMatrix& matrix)
+    {
+        const double INFINITE_DISTANCE = numeric_limits<double>::infinity();
+        int n = matrix.size() - 1;
+        int width = (n + 3) & ~3;
+        size_t rows = size_t(1) << n;
+        vector<double> best(rows * width, INFINITE_DISTANCE);
+        //into[j*width + k]: drive from stop k to stop j, so a row lines up
+        //with the row of best it is added to
+        vector<double> into(static_cast<size_t>(width) * n, INFINITE_DISTANCE);
+        for (int j = 0; j < n; j++)
+        {
+            for (int k = 0; k < n; k++)
+                into[j * width + k] = matrix.distance(k + 1, j + 1);
+        }
+
+        for (int j = 0; j < n; j++)
+            best[(size_t(1) << j) * width + j] = matrix.distance(0, j + 1);
+        for (size_t set = 1; set < rows; set++)
+        {
+            if ((set & (set - 1)) == 0)
+                continue; //one stop: straight from the depot
+            double* row = &best[set * width];
+            for (int j = 0; j < n; j++)
+            {
+                if (set & (size_t(1) << j))
+                    row[j] = minSum(&best[(set ^ (size_t(1) << j)) * width], &into[j * width], width);
+            }
+        }
+
+        //the best last stop, then walk back: the stop before each one is the
+        //one its entry was the minimum over
+        size_t set = rows - 1;
+        int last = 0;
+        for (int j = 1; j < n; j++)
+        {
+            if (best[set * width + j] + matrix.distance(j + 1, 0) < best[set * width + last] + matrix.distance(last + 1, 0))
+                last = j;
+        }
+        vector<int> order(n);
+        for (int i = n - 1; i >= 0; i--)
+        {
+            order[i] = last + 1;
+            set ^= size_t(1) << last;
+            int previous = -1;
+            for (int k = 0; k < n && set != 0; k++)
+            {
+                if ((set & (size_t(1) << k)) && (previous < 0 ||
+                    best[set * width + k] + into[last * width + k] < best[set * width + previous] + into[last * width + previous]))
+                    previous = k;
+            }
+            last = previous;
+        }
+        return order;
+    }
+
+    //cut order into four runs A B C D and reconnect them as A C B D, a change
+    //2-opt and Or-opt can't undo in one move; false if order is too short
+    bool doubleBridge(vector<int>& order, Random& random)
+    {
+        int n = static_cast<int>(order.size());
+        if (n < 8)
+            return false;
+        int cut[3];
+        do
+        {
+            for (int c = 0; c < 3; c++)
+                cut[c] = 1 + random.below(n - 1);
+            sort(cut, cut + 3);
+        } while (cut[0] == cut[1] || cut[1] == cut[2]);
+        vector<int> kicked(order.begin(), order.begin() + cut[0]);
+        kicked.insert(kicked.end(), order.begin() + cut[1], order.begin() + cut[2]);
+        kicked.insert(kicked.end(), order.begin() + cut[0], order.begin() + cut[1]);
+        kicked.insert(kicked.end(), order.begin() + cut[2], order.end());
+        order.swap(kicked);
+        return true;
+    }
+}
+
 class DeliveryOptimizerImpl
 {
 public:
@@ -14,12 +384,21 @@ public:
         const GeoCoord& depot,
         vector<DeliveryRequest>& deliveries,
         double& oldCrowDistance,
-        double& newCrowDistance) const;
+        double& newCrowDistance,
+        const OptimizerOptions& options,
+        OptimizerStats& stats) const;
 private:
+    const StreetMap* m_sm;
+
     double calculateProbability(double currentDis, double copyDis, double temperature) const;
+    double crowDistance(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries) const;
+    void anneal(Chain& chain, long long iterations, double cooling, Deadline& deadline) const;
+    void localSearch(Tour& tour, const vector<vector<int>>& neighbors, OptimizerStats& stats, Deadline& deadline) const;
+    void kick(Chain& chain, const vector<vector<int>>& neighbors, long long kicks, Deadline& deadline) const;
 };
 
 DeliveryOptimizerImpl::DeliveryOptimizerImpl(const StreetMap* sm)
+ : m_sm(sm)
 {
 }
 
@@ -36,80 +415,350 @@ double DeliveryOptimizerImpl::calculateProbability(double currentDis, double cop
         return exp((currentDis-copyDis)/temperature);
 }
 
+double DeliveryOptimizerImpl::crowDistance(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries) const
+{
+    double dis = 0;
+    GeoCoord g(depot);
+    for (size_t i = 0; i < deliveries.size(); i++)
+    {
+        dis += distanceEarthMiles(g, deliveries[i].location);
+        g = deliveries[i].location;
+    }
+    return dis + distanceEarthMiles(g, depot);
+}
+
+void DeliveryOptimizerImpl::anneal(Chain& chain, long long iterations, double cooling, Deadline& deadline) const
+{
+    Tour& tour = chain.tour;
+    int n = tour.stops();
+    double temp;
+    double currentDis = tour.length();
+
+    for (long long i = 0; i < iterations; i++)
+    {
+        if (i % CLOCK_CHECK_INTERVAL == 0)
+        {
+            if (deadline.passed())
+                return;
+            //with a deadline, cool at least as fast as the clock runs out
+            chain.temperature = min(chain.temperature, chain.startTemperature * pow(1e-3, deadline.progress()));
+        }
+        chain.stats.iterations++;
+
+        //cool
+        chain.temperature *= cooling;
+
+        //pick a random move: swap two stops, reverse the run between two
+        //stops, or move a run of up to three stops somewhere else
+        int move = chain.random.below(3);
+        int pos1 = 1 + chain.random.below(n);
+        int pos2 = 1 + chain.random.below(n);
+        int count = 1 + chain.random.below(3);
+        if (move != 2)
+        {
+            if (pos1 == pos2)
+                continue;
+            if (pos1 > pos2)
+                swap(pos1, pos2);
+        }
+        else
+        {
+            //pos2 becomes the position to insert after, outside the run
+            if (pos1 + count - 1 > n)
+                count = n - pos1 + 1;
+            pos2 = chain.random.below(n + 1);
+            if (pos2 >= pos1 - 1 && pos2 <= pos1 + count - 1)
+                continue;
+        }
+
+        double delta;
+        if (move == 0)
+            delta = tour.swapDelta(pos1, pos2);
+        else if (move == 1)
+            delta = tour.reverseDelta(pos1, pos2);
+        else
+            delta = tour.relocateDelta(pos1, count, pos2);
+        chain.stats.movesTried++;
+
+        //decide if we should accept the move
+        temp = calculateProbability(currentDis,currentDis+delta,chain.temperature);
+
+        if (temp > chain.random.uniform())
+        {
+            if (move == 0)
+                tour.swap(pos1, pos2);
+            else if (move == 1)
+                tour.reverse(pos1, pos2);
+            else
+                tour.relocate(pos1, count, pos2);
+            currentDis = tour.length();
+            chain.stats.movesMade++;
+
+            //keep track of best
+            chain.keepIfBest();
+        }
+    }
+}
+
+void DeliveryOptimizerImpl::localSearch(Tour& tour, const vector<vector<int>>& neighbors, OptimizerStats& stats, Deadline& deadline) const
+{
+    //first improvement: make any move that helps, and repeat until a whole
+    //pass over the stops finds none.  Moves only join a stop to one of its
+    //nearest stops, since good tours rarely have long legs.
+    int n = tour.stops();
+    bool improved = true;
+    while (improved && !deadline.passed())
+    {
+        improved = false;
+        for (int i = 1; i <= n; i++)
+        {
+            int x = tour.at(i);
+            for (size_t k = 0; k < neighbors[x].size(); k++)
+            {
+                int j = tour.position(neighbors[x][k]);
+
+                //2-opt: reverse the run between them, so that x drives
+                //straight to the neighbor, or the neighbor to x
+                if (j > i + 1)
+                {
+                    stats.movesTried++;
+                    if (tour.reverseDelta(i + 1, j) < -MIN_GAIN)
+                    {
+                        tour.reverse(i + 1, j);
+                        stats.movesMade++;
+                        improved = true;
+                        break;
+                    }
+                }
+                else if (j < i - 1)
+                {
+                    stats.movesTried++;
+                    if (tour.reverseDelta(j, i - 1) < -MIN_GAIN)
+                    {
+                        tour.reverse(j, i - 1);
+                        stats.movesMade++;
+                        improved = true;
+                        break;
+                    }
+                }
+
+                //Or-opt: move the run of up to three stops starting at x to
+                //just after or just before the neighbor
+                bool moved = false;
+                for (int count = 1; count <= 3 && i + count - 1 <= n && !moved; count++)
+                {
+                    int last = i + count - 1;
+                    for (int p = j - 1; p <= j && !moved; p++)
+                    {
+                        if (p >= i - 1 && p <= last)
+                            continue;
+                        stats.movesTried++;
+                        if (tour.relocateDelta(i, count, p) < -MIN_GAIN)
+                        {
+                            tour.relocate(i, count, p);
+                            stats.movesMade++;
+                            moved = true;
+                        }
+                    }
+                }
+                if (moved)
+                {
+                    improved = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void DeliveryOptimizerImpl::kick(Chain& chain, const vector<vector<int>>& neighbors, long long kicks, Deadline& deadline) const
+{
+    //kick the chain's best tour, improve the result, and keep it if it's
+    //shorter, in the manner of chained Lin-Kernighan
+    for (long long k = 0; k < kicks && !deadline.passed(); k++)
+    {
+        vector<int> kicked(chain.best);
+        if (!doubleBridge(kicked, chain.random))
+            return;
+        chain.stats.iterations++;
+        chain.tour.setOrder(kicked);
+        localSearch(chain.tour, neighbors, chain.stats, deadline);
+        chain.keepIfBest();
+    }
+}
+
 void DeliveryOptimizerImpl::optimizeDeliveryOrder(
     const GeoCoord& depot,
     vector<DeliveryRequest>& deliveries,
     double& oldCrowDistance,
-    double& newCrowDistance) const
+    double& newCrowDistance,
+    const OptimizerOptions& options,
+    OptimizerStats& stats) const
 {
-    unsigned seed = time(NULL);
-    srand(seed);
-   
-    double temp;
-    double temperature = 10000;
-    //vector<DeliveryRequest> potential(deliveries);
-    vector<DeliveryRequest> current(deliveries);
-    double potentialDis;
-    double deliveriesDis, currentDis;
-    GeoCoord g(depot);
-    //calculate distance
-    for (int i = 0; i < deliveries.size(); i++)
+    auto startTime = chrono::steady_clock::now();
+    Deadline deadline(startTime, options.deadlineSeconds);
+    stats = OptimizerStats();
+    oldCrowDistance = newCrowDistance = crowDistance(depot, deliveries);
+    if (deliveries.empty())
+        return;
+
+    //tours are scored by road distance: one batch of searches up front gives
+    //the distance between every pair of stops
+    vector<GeoCoord> stops;
+    stops.push_back(depot);
+    for (size_t i = 0; i < deliveries.size(); i++)
+        stops.push_back(deliveries[i].location);
+    DistanceMatrix matrix;
+    chrono::steady_clock::time_point matrixDeadline = chrono::steady_clock::time_point::max();
+    if (options.deadlineSeconds > 0)
+        matrixDeadline = startTime + chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(options.deadlineSeconds));
+    matrix.compute(*m_sm->graph(), stops, options.matrixThreads, matrixDeadline);
+    stats.matrixCrowRows = matrix.crowRows();
+    if (stats.matrixCrowRows > 0)
+        deadline.passed(); //notes that the deadline was reached
+    stats.matrixSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+    //every strategy works on a permutation of matrix indexes; a move is scored
+    //by the change it makes to the tour's length, and only accepted moves are made
+    Tour given(matrix);
+    stats.oldRoadDistance = given.length();
+    vector<int> best = given.order();
+    int n = given.stops();
+    if (n >= 2 && n <= min(options.exactStops, MAX_EXACT_STOPS))
     {
-        oldCrowDistance += distanceEarthMiles(g, deliveries[i].location);
-        g = deliveries[i].location;
+        //small batches are solved exactly
+        best = shortestOrder(matrix);
+        stats.exact = stats.converged = true;
     }
-    //dont forget back to depot
-    oldCrowDistance += distanceEarthMiles(g, depot);
-    
-    deliveriesDis = currentDis = oldCrowDistance;
-    int threshhold = pow(deliveries.size(),3);
-    
-    
-    for (int i = 0; i < threshhold; i++) 
+    else if (n >= 2)
     {
-        vector<DeliveryRequest>potential(current);
-        
-        //get random positions to be swapped
-        int pos1 = rand() % potential.size();
-        int pos2 = rand() % potential.size();
-
-        //shuffle
-        iter_swap(potential.begin()+pos1, potential.begin()+pos2);
-        
-        //get the new distance
-        g = depot;
-        potentialDis = 0;
-        for (int i = 0; i < potential.size(); i++)
-        {
-            potentialDis += distanceEarthMiles(g, potential[i].location);
-            g = potential[i].location;
-        }
-        //dont forget back to depot
-        potentialDis += distanceEarthMiles(g, depot);
-        
-        
-        //decide if we should accept swap
-        temp = calculateProbability(currentDis,potentialDis,temperature);
-        
-        if (temp > rand()%2)
-        {
-            current = potential;
-            currentDis = potentialDis;
-        }
-        
-        //keep track of best, place in deliveries vector
-        if (currentDis < deliveriesDis)
-        {
-            deliveries = current;
-            deliveriesDis = currentDis;
+        //independent chains, each seeded by its number, so the result depends
+        //on the seed and the number of chains but not on the thread count
+        unsigned threads = max(1u, options.threads);
+        int starts = options.starts > 0 ? options.starts : static_cast<int>(threads);
+        vector<Chain> chains;
+        for (int c = 0; c < starts; c++)
+            chains.push_back(Chain(matrix, options.seed, c));
+
+        vector<vector<int>> neighbors;
+        if (options.strategy != OPTIMIZE_ANNEALING)
+            neighbors = nearestStops(matrix);
+
+        //each chain's budget is annealing moves or kicks; by default n^3
+        //moves or 10n kicks.  The annealer starts from the given order, around
+        //one leg's length, and cools geometrically to a thousandth of that
+        //over the budget.
+        long long budget = options.iterationBudget;
+        if (options.strategy == OPTIMIZE_LOCAL_SEARCH)
+            budget = 0;
+        else if (budget <= 0)
+            budget = options.strategy == OPTIMIZE_ANNEALING ? static_cast<long long>(n) * n * n : 10 * n;
+        stats.iterationBudget = budget * starts;
+        double cooling = budget > 0 ? pow(1e-3, 1.0 / budget) : 1;
+        int exchanges = options.strategy == OPTIMIZE_LOCAL_SEARCH ? 0 : EXCHANGES;
+
+        ChainWorkers workers(starts, threads);
+        workers.run([&](int c) {
+            Chain& chain = chains[c];
+            if (options.strategy == OPTIMIZE_ANNEALING)
+                chain.temperature = chain.startTemperature = given.length() / (n + 1);
+            else
+            {
+                //the first chain improves the nearest-neighbor tour, the
+                //others kicked copies of it, so they start apart
+                vector<int> order = nearestNeighborOrder(matrix);
+                for (int k = 0; k < c; k++)
+                    doubleBridge(order, chain.random);
+                chain.tour.setOrder(order);
+                localSearch(chain.tour, neighbors, chain.stats, deadline);
+            }
+            chain.keepIfBest();
+        });
+
+        stats.converged = options.strategy == OPTIMIZE_LOCAL_SEARCH && !deadline.reached();
+        for (int e = 0; e < exchanges && !deadline.passed(); e++)
+        {
+            //every chain that isn't the best carries on from the best tour so far
+            if (e > 0)
+            {
+                int leader = 0;
+                for (int c = 1; c < starts; c++)
+                {
+                    if (chains[c].bestDis < chains[leader].bestDis)
+                        leader = c;
+                }
+                for (int c = 0; c < starts; c++)
+                {
+                    if (c != leader && chains[leader].bestDis < chains[c].bestDis - MIN_GAIN)
+                    {
+                        chains[c].best = chains[leader].best;
+                        chains[c].bestDis = chains[leader].bestDis;
+                        chains[c].tour.setOrder(chains[c].best);
+                    }
+                }
+            }
+            vector<long long> movesMade(starts);
+            vector<double> bestDis(starts);
+            for (int c = 0; c < starts; c++)
+            {
+                movesMade[c] = chains[c].stats.movesMade;
+                bestDis[c] = chains[c].bestDis;
+            }
+            long long first = budget * e / exchanges;
+            long long slice = budget * (e + 1) / exchanges - first;
+            workers.run([&](int c) {
+                if (options.strategy == OPTIMIZE_ANNEALING)
+                    anneal(chains[c], slice, cooling, deadline);
+                else
+                    kick(chains[c], neighbors, slice, deadline);
+            });
+            if (deadline.reached())
+                break;
+
+            //stop early once the chains have converged: the annealers have
+            //frozen (accepted no move all epoch), or no kick found a shorter tour
+            bool converged = true;
+            for (int c = 0; c < starts && converged; c++)
+            {
+                if (options.strategy == OPTIMIZE_ANNEALING)
+                    converged = chains[c].stats.movesMade == movesMade[c];
+                else
+                    converged = chains[c].bestDis == bestDis[c];
+            }
+            if (converged)
+            {
+                stats.converged = true;
+                break;
+            }
         }
 
-        //cool
-        temperature *= 0.8;
+        //lowest-numbered chain wins ties, so the answer doesn't depend on timing
+        int leader = 0;
+        for (int c = 0; c < starts; c++)
+        {
+            stats.movesTried += chains[c].stats.movesTried;
+            stats.movesMade += chains[c].stats.movesMade;
+            stats.iterations += chains[c].stats.iterations;
+            if (chains[c].bestDis < chains[leader].bestDis)
+                leader = c;
+        }
+        //never hand back something worse than what we were given
+        if (chains[leader].bestDis < stats.oldRoadDistance)
+            best = chains[leader].best;
     }
+    given.setOrder(best);
+    stats.newRoadDistance = given.length();
 
-    newCrowDistance = deliveriesDis;
-    
+    //place the best order in deliveries vector
+    vector<DeliveryRequest> ordered;
+    ordered.reserve(deliveries.size());
+    for (size_t i = 0; i < best.size(); i++)
+        ordered.push_back(deliveries[best[i] - 1]);
+    deliveries = ordered;
+    newCrowDistance = crowDistance(depot, deliveries);
+    stats.stoppedAtDeadline = deadline.reached();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
 }
 
 //******************** DeliveryOptimizer functions ****************************
@@ -133,5 +782,17 @@ void DeliveryOptimizer::optimizeDeliveryOrder(
         double& oldCrowDistance,
         double& newCrowDistance) const
 {
-    return m_impl->optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance);
+    OptimizerStats stats;
+    return m_impl->optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance, OptimizerOptions(), stats);
+}
+
+void DeliveryOptimizer::optimizeDeliveryOrder(
+        const GeoCoord& depot,
+        vector<DeliveryRequest>& deliveries,
+        double& oldCrowDistance,
+        double& newCrowDistance,
+        const OptimizerOptions& options,
+        OptimizerStats& stats) const
+{
+    return m_impl->optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance, options, stats);
 }
@@ -1,10 +1,20 @@
 #include "provided.h"
+#include "WorkStealingPool.h"
 #include <vector>
 #include <utility>
 #include <list>
 #include <iostream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
 using namespace std;
 
+namespace
+{
+    //a leg is one search, so a thread is only worth starting for several
+    const int LEGS_PER_THREAD = 4;
+}
+
 class DeliveryPlannerImpl
 {
 public:
@@ -15,9 +25,21 @@ public:
         const vector<DeliveryRequest>& deliveries,
         vector<DeliveryCommand>& commands,
         double& totalDistanceTravelled) const;
+    void generateDeliveryPlans(
+        const vector<DeliveryJob>& jobs,
+        vector<DeliveryJobResult>& results,
+        unsigned threads,
+        BatchPlanStats& stats) const;
 private:
     const StreetMap* m_sm;
     string getProceedAngle(double dir) const;
+    DeliveryResult plan(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        vector<DeliveryCommand>& commands,
+        double& totalDistanceTravelled,
+        const OptimizerOptions& options,
+        OptimizerStats& optimizerStats) const;
 };
 
 string DeliveryPlannerImpl::getProceedAngle(double dir) const
@@ -58,55 +80,112 @@ DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
     const vector<DeliveryRequest>& deliveries,
     vector<DeliveryCommand>& commands,
     double& totalDistanceTravelled) const
+{
+    OptimizerStats optimizerStats;
+    return plan(depot, deliveries, commands, totalDistanceTravelled, OptimizerOptions(), optimizerStats);
+}
+
+void DeliveryPlannerImpl::generateDeliveryPlans(
+    const vector<DeliveryJob>& jobs,
+    vector<DeliveryJobResult>& results,
+    unsigned threads,
+    BatchPlanStats& stats) const
+{
+    auto startTime = chrono::steady_clock::now();
+    results.assign(jobs.size(), DeliveryJobResult());
+
+    //the jobs are the parallelism, so each one computes its distance matrix
+    //and routes its legs on its own thread; each job has its own optimizer
+    //and router, and only reads the map
+    OptimizerOptions options;
+    options.matrixThreads = 1;
+    options.legThreads = 1;
+    WorkStealingPool pool(threads);
+    pool.run(static_cast<int>(jobs.size()), [&](int i, unsigned) {
+        auto jobStart = chrono::steady_clock::now();
+        DeliveryJobResult& r = results[i];
+        r.result = plan(jobs[i].depot, jobs[i].deliveries, r.commands, r.totalDistanceTravelled,
+                        options, r.optimizerStats);
+        r.seconds = chrono::duration<double>(chrono::steady_clock::now() - jobStart).count();
+    });
+
+    stats.jobs = static_cast<int>(jobs.size());
+    stats.threads = pool.threads();
+    stats.steals = pool.steals();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+DeliveryResult DeliveryPlannerImpl::plan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    vector<DeliveryCommand>& commands,
+    double& totalDistanceTravelled,
+    const OptimizerOptions& options,
+    OptimizerStats& optimizerStats) const
 {
     double d,dd;
     DeliveryOptimizer optimizer(m_sm);
     vector<DeliveryRequest> orderedDeliveries;
     //create a copy of the deliveries vector to optimize
-    for (int i = 0; i < deliveries.size(); i++)
+    for (size_t i = 0; i < deliveries.size(); i++)
     {
         orderedDeliveries.push_back(deliveries[i]);
     }
-    optimizer.optimizeDeliveryOrder(depot, orderedDeliveries, d, dd);
+    optimizer.optimizeDeliveryOrder(depot, orderedDeliveries, d, dd, options, optimizerStats);
     
     bool justTurnedOrDelivered = true;
-    bool returned = false;
     PointToPointRouter router(m_sm);
-    list<StreetSegment> temp;
     vector<pair<DeliveryRequest,list<StreetSegment>>> plan;
-    GeoCoord g = depot;
+    vector<vector<double>> planMiles; //of each segment, as the router counted it
     totalDistanceTravelled = 0;
     
-    //for every delivery request, generate route
-    for (int i = 0; i < orderedDeliveries.size(); i++)
+    //generate the route for every leg: depot to the first delivery, each
+    //delivery to the next, and the last one back to depot.  The legs are
+    //independent searches, so with enough of them they run on several
+    //threads at once and the plan waits about as long as for the longest;
+    //the router's search state is per thread.
+    int legCount = static_cast<int>(orderedDeliveries.size()) + 1;
+    unsigned legThreads = options.legThreads;
+    if (legThreads == 0)
+        legThreads = min(max(1u, thread::hardware_concurrency()), static_cast<unsigned>(max(legCount / LEGS_PER_THREAD, 1)));
+    vector<list<StreetSegment>> legRoutes(legCount);
+    vector<vector<double>> legMiles(legCount);
+    vector<double> legDistances(legCount, 0);
+    vector<DeliveryResult> legResults(legCount, DELIVERY_SUCCESS);
+    WorkStealingPool pool(legThreads);
+    pool.run(legCount, [&](int i, unsigned) {
+        const GeoCoord& from = i == 0 ? depot : orderedDeliveries[i - 1].location;
+        const GeoCoord& to = i < legCount - 1 ? orderedDeliveries[i].location : depot;
+        RouteStats stats;
+        legResults[i] = router.generatePointToPointRoute(from, to, legRoutes[i], legMiles[i], legDistances[i], stats);
+    });
+    
+    //stitch them together in order
+    DeliveryRequest back("", depot);
+    for (int i = 0; i < legCount; i++)
     {
-        DeliveryResult result = router.generatePointToPointRoute(g, orderedDeliveries[i].location, temp, d);
-        if (result == NO_ROUTE || result == BAD_COORD)
+        if (legResults[i] == NO_ROUTE || legResults[i] == BAD_COORD)
             //if the coord is bad or there is no route
-            return result;
+            return legResults[i];
         //add distance between points to the total distance travelled
-        totalDistanceTravelled += d;
-        plan.push_back(make_pair(orderedDeliveries[i],temp));
-        //the next "start" coord is the old end
-        g = orderedDeliveries[i].location;
+        totalDistanceTravelled += legDistances[i];
+        plan.push_back(make_pair(i < legCount - 1 ? orderedDeliveries[i] : back, list<StreetSegment>()));
+        plan.back().second.swap(legRoutes[i]);
+        planMiles.push_back(vector<double>());
+        planMiles.back().swap(legMiles[i]);
     }
     
-    //return to depot
-    DeliveryRequest back("", depot);
-    router.generatePointToPointRoute(g, depot, temp, d);
-    totalDistanceTravelled += d;
-    plan.push_back(make_pair(back,temp));
-    
     //for all of the delivery requests
-    for (int i = 0; i < plan.size(); i++)
+    for (size_t i = 0; i < plan.size(); i++)
     {
         string s = "";
         //for all of the street segments in each delivery route
-        for (auto it = plan[i].second.begin(); it != plan[i].second.end() ; it++)
+        auto miles = planMiles[i].begin();
+        for (auto it = plan[i].second.begin(); it != plan[i].second.end() ; it++, miles++)
         {
             //make proceed command
             DeliveryCommand proceed;
-            double dis = distanceEarthMiles(it->start, it->end);
+            double dis = *miles;
                     
             if (!justTurnedOrDelivered && !commands.empty() && commands.back().streetName() == it->name)
             //if we should just be extending the previous proceed command
@@ -128,12 +207,6 @@ DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
                 commands.push_back(proceed);
                 justTurnedOrDelivered = false;
             }
-            //if we have reached the end, break
-            if (it->end == depot)
-            {
-                returned = true;
-                break;
-            }
         
             //get angle between two segments to determine if next command is turn or proceed
             StreetSegment current = *it;
@@ -176,8 +249,9 @@ DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
             }
             it--; //reset iterator
         }
-        if (returned)
-            //if we have returned, return success
+        if (i == plan.size() - 1)
+            //the last leg is the one back to depot, so we have returned:
+            //return success
             return DELIVERY_SUCCESS;
         DeliveryCommand deliver;
         deliver.initAsDeliverCommand(plan[i].first.item);
@@ -210,3 +284,12 @@ DeliveryResult DeliveryPlanner::generateDeliveryPlan(
 {
     return m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled);
 }
+
+void DeliveryPlanner::generateDeliveryPlans(
+    const vector<DeliveryJob>& jobs,
+    vector<DeliveryJobResult>& results,
+    unsigned threads,
+    BatchPlanStats& stats) const
+{
+    return m_impl->generateDeliveryPlans(jobs, results, threads, stats);
+}
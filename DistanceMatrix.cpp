@@ -0,0 +1,166 @@
+#include "provided.h"
+#include "DistanceMatrix.h"
+#include "IndexedHeap.h"
+#include "CrowPoints.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    const double INFINITE_DISTANCE = numeric_limits<double>::infinity();
+    //nodes settled between looks at the clock
+    const int CLOCK_CHECK_INTERVAL = 1024;
+
+    // One thread's search state, reused for every row it computes; only the
+    // entries a search touched are reset afterwards.
+    struct RowSearch
+    {
+        IndexedHeap heap;
+        vector<double> dist;
+        vector<int> touched;
+        vector<char> isTarget;
+
+        explicit RowSearch(int n)
+         : heap(n), dist(n, INFINITE_DISTANCE), isTarget(n, 0)
+        {}
+
+        //Dijkstra from source until every target node is settled; returns
+        //false, leaving dist unfinished, if the deadline passes first
+        bool run(const StreetGraph& graph, int source, const vector<int>& targets,
+                 chrono::steady_clock::time_point deadline)
+        {
+            int remaining = 0;
+            for (int t : targets)
+            {
+                if (!isTarget[t])
+                {
+                    isTarget[t] = 1;
+                    remaining++;
+                }
+            }
+            dist[source] = 0;
+            touched.push_back(source);
+            heap.pushOrDecrease(source, 0);
+            bool finished = true;
+            for (int settled = 0; !heap.empty() && remaining > 0; settled++)
+            {
+                if (settled % CLOCK_CHECK_INTERVAL == CLOCK_CHECK_INTERVAL - 1 &&
+                    chrono::steady_clock::now() >= deadline)
+                {
+                    finished = false;
+                    break;
+                }
+                int u = heap.pop();
+                if (isTarget[u])
+                    remaining--;
+                for (int e : graph.edges(u))
+                {
+                    int v = graph.edgeTarget(e);
+                    double d = dist[u] + graph.edgeLength(e);
+                    if (d < dist[v])
+                    {
+                        if (dist[v] == INFINITE_DISTANCE)
+                            touched.push_back(v);
+                        dist[v] = d;
+                        heap.pushOrDecrease(v, d);
+                    }
+                }
+            }
+            //every target is settled or unreachable by now; whatever is left
+            //queued is past the farthest one
+            heap.clear();
+            for (int t : targets)
+                isTarget[t] = 0;
+            return finished;
+        }
+
+        void reset()
+        {
+            for (int v : touched)
+                dist[v] = INFINITE_DISTANCE;
+            touched.clear();
+        }
+    };
+}
+
+DistanceMatrix::DistanceMatrix()
+ : m_size(0), m_crowFallbacks(0), m_crowRows(0)
+{
+}
+
+void DistanceMatrix::compute(const StreetGraph& graph, const vector<GeoCoord>& points, unsigned threads,
+                             chrono::steady_clock::time_point deadline)
+{
+    m_size = static_cast<int>(points.size());
+    m_distance.assign(static_cast<size_t>(m_size) * m_size, 0);
+    m_crowFallbacks = 0;
+    m_crowRows = 0;
+
+    vector<int> nodes(m_size);
+    vector<int> targets;
+    for (int i = 0; i < m_size; i++)
+    {
+        nodes[i] = graph.nodeId(points[i]);
+        if (nodes[i] >= 0)
+            targets.push_back(nodes[i]);
+    }
+
+    //rows are handed out one at a time, so a slow row doesn't hold up a thread's others
+    atomic<int> nextRow(0);
+    atomic<int> fallbacks(0);
+    atomic<int> crowRows(0);
+    atomic<bool> pastDeadline(false); //once a search runs out of time, no more are started
+    CrowPoints crowPoints;
+    crowPoints.assign(points);
+    auto work = [&]() {
+        RowSearch search(graph.nodeCount());
+        vector<double> crow(m_size);
+        for (int i = nextRow++; i < m_size; i = nextRow++)
+        {
+            double* row = &m_distance[static_cast<size_t>(i) * m_size];
+            bool searched = false;
+            if (nodes[i] >= 0 && !pastDeadline)
+            {
+                searched = search.run(graph, nodes[i], targets, deadline);
+                if (!searched)
+                    pastDeadline = true;
+            }
+            if (nodes[i] >= 0 && !searched)
+                crowRows++;
+            bool haveCrow = false; //the row's crow distances, worked out all at once if any is needed
+            for (int j = 0; j < m_size; j++)
+            {
+                if (i == j)
+                    continue;
+                double d = searched && nodes[j] >= 0 ? search.dist[nodes[j]] : INFINITE_DISTANCE;
+                if (d == INFINITE_DISTANCE)
+                {
+                    if (!haveCrow)
+                        crowPoints.oneToMany(i, crowPoints, crow.data());
+                    haveCrow = true;
+                    d = crow[j];
+                    fallbacks++;
+                }
+                row[j] = d;
+            }
+            search.reset();
+        }
+    };
+
+    if (threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+    threads = min(threads, static_cast<unsigned>(max(m_size, 1)));
+    vector<thread> workers;
+    for (unsigned t = 1; t < threads; t++)
+        workers.push_back(thread(work));
+    work();
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+    m_crowFallbacks = fallbacks;
+    m_crowRows = crowRows;
+}
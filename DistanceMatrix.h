@@ -0,0 +1,49 @@
+// DistanceMatrix.h
+
+// Road distances between every pair of a batch of points (a depot and its
+// delivery locations).  Each row comes from one Dijkstra search from that
+// point, which stops as soon as every other point is settled, so N points
+// cost N one-to-many searches rather than N*N point-to-point ones.  Rows are
+// independent and are searched on all cores.
+//
+// A point that is not a node of the map, or a pair with no route between
+// them, gets the crow-fly distance instead, so every tour still has a finite
+// length for the optimizer to compare; the planner reports such legs when it
+// routes them.  So does every row whose search the deadline doesn't leave
+// time for: searches look at the clock as they go, and once one runs past
+// the deadline its row and every row not yet started are crow-fly.
+
+#ifndef DISTANCEMATRIX_INCLUDED
+#define DISTANCEMATRIX_INCLUDED
+
+#include "provided.h"
+#include "StreetGraph.h"
+#include <chrono>
+#include <vector>
+
+class DistanceMatrix
+{
+public:
+    DistanceMatrix();
+
+      // replaces the matrix with the distances between points, searching on
+      // up to threads threads (0 means one per core) until deadline
+    void compute(const StreetGraph& graph, const std::vector<GeoCoord>& points, unsigned threads = 0,
+                 std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    int size() const { return m_size; }
+      // miles driven from point from to point to
+    double distance(int from, int to) const { return m_distance[static_cast<size_t>(from) * m_size + to]; }
+      // number of pairs that fell back to the crow-fly distance
+    int crowFallbacks() const { return m_crowFallbacks; }
+      // number of rows of points on the map that the deadline left crow-fly
+    int crowRows() const { return m_crowRows; }
+
+private:
+    int m_size;
+    std::vector<double> m_distance; //row-major
+    int m_crowFallbacks;
+    int m_crowRows;
+};
+
+#endif // DISTANCEMATRIX_INCLUDED
@@ -0,0 +1,107 @@
+#include "provided.h"
+#include "EdgeCosts.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    //speed classes, checked in order against the words of a street's name
+    struct SpeedClass
+    {
+        const char* word;
+        double mph;
+    };
+
+    const SpeedClass SPEED_CLASSES[] = {
+        { "Freeway", 55 }, { "Interstate", 55 }, { "Expressway", 50 }, { "Highway", 45 },
+        { "Boulevard", 35 }, { "Parkway", 35 }, { "Avenue", 30 }, { "Road", 30 },
+        { "Alley", 10 }, { "Driveway", 10 }, { "Lane", 20 }, { "Court", 20 }, { "Place", 20 },
+    };
+    const double DEFAULT_MPH = 25;
+}
+
+const double EdgeCosts::LEFT_TURN_MINUTES = 0.4;
+const double EdgeCosts::RIGHT_TURN_MINUTES = 0.15;
+const double EdgeCosts::U_TURN_MINUTES = 1.0;
+const double EdgeCosts::STRAIGHT_SINE = 0.0174524; //sin(1 degree)
+
+EdgeCosts::EdgeCosts()
+ : m_graph(nullptr), m_fastestMinutesPerMile(0)
+{
+}
+
+void EdgeCosts::clear()
+{
+    m_graph = nullptr;
+    vector<double>().swap(m_minutesPerMile);
+    vector<float>().swap(m_dirX);
+    vector<float>().swap(m_dirY);
+    m_fastestMinutesPerMile = 0;
+}
+
+double EdgeCosts::streetMph(const string& name)
+{
+    for (const SpeedClass& c : SPEED_CLASSES)
+    {
+        //whole words only, so "Courtney Street" isn't a court
+        size_t at = name.find(c.word);
+        size_t end = at + strlen(c.word);
+        if (at != string::npos && (at == 0 || name[at - 1] == ' ') && (end == name.size() || name[end] == ' '))
+            return c.mph;
+    }
+    return DEFAULT_MPH;
+}
+
+void EdgeCosts::build(const StreetGraph& graph)
+{
+    clear();
+    int m = graph.edgeCount();
+    if (graph.nodeCount() == 0)
+        return;
+    m_graph = &graph;
+
+    //names are shared by many edges, so each is classified once
+    vector<double> nameMinutesPerMile;
+    m_minutesPerMile.resize(m);
+    m_dirX.resize(m);
+    m_dirY.resize(m);
+    m_fastestMinutesPerMile = numeric_limits<double>::infinity();
+    for (int e = 0; e < m; e++)
+    {
+        int name = graph.edgeNameId(e);
+        if (name >= static_cast<int>(nameMinutesPerMile.size()))
+            nameMinutesPerMile.resize(name + 1, 0);
+        if (nameMinutesPerMile[name] == 0)
+            nameMinutesPerMile[name] = 60 / streetMph(graph.edgeName(e));
+        m_minutesPerMile[e] = nameMinutesPerMile[name];
+        m_fastestMinutesPerMile = min(m_fastestMinutesPerMile, m_minutesPerMile[e]);
+
+        //the same flat latitude and longitude angles as angleBetween2Lines
+        int s = graph.edgeSource(e);
+        int t = graph.edgeTarget(e);
+        double dx = graph.longitude(t) - graph.longitude(s);
+        double dy = graph.latitude(t) - graph.latitude(s);
+        double length = sqrt(dx * dx + dy * dy);
+        m_dirX[e] = length > 0 ? static_cast<float>(dx / length) : 0;
+        m_dirY[e] = length > 0 ? static_cast<float>(dy / length) : 0;
+    }
+    if (m == 0)
+        m_fastestMinutesPerMile = 60 / DEFAULT_MPH;
+}
+
+double EdgeCosts::routeMinutes(const vector<int>& path) const
+{
+    double minutes = 0;
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        minutes += edgeMinutes(path[i]);
+        if (i > 0)
+            minutes += turnMinutes(path[i - 1], path[i]);
+    }
+    return minutes;
+}
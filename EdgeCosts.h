@@ -0,0 +1,80 @@
+// EdgeCosts.h
+
+// What a route costs in time rather than miles, for the routers' cost
+// profiles.  Each street's name puts it in a speed class (a freeway is faster
+// than a boulevard, which is faster than a side street), and a route also
+// loses time wherever the driver turns onto another street, most at left
+// turns and U-turns.  Everything a search needs is worked out once per map
+// into flat per-edge arrays: the minutes per mile of the edge's street and
+// the direction it leaves in, so classifying a turn during a search takes a
+// cross and a dot product and no trigonometry.
+//
+// Turns are classified the way DeliveryPlanner words its turn commands: a
+// change of street at an angle of at least a degree is a turn, to the left if
+// the angle is under 180 degrees.  Times scale with the edges' live lengths,
+// so they follow closures and other changes to the map.
+
+#ifndef EDGECOSTS_INCLUDED
+#define EDGECOSTS_INCLUDED
+
+#include "StreetGraph.h"
+#include <string>
+#include <vector>
+
+class EdgeCosts
+{
+public:
+    EdgeCosts();
+    void clear();
+      // works out the costs of every edge of graph, which must outlive them
+      // or the next build
+    void build(const StreetGraph& graph);
+    bool empty() const { return m_graph == nullptr; }
+
+      // the assumed speed on a street, from its name
+    static double streetMph(const std::string& name);
+
+    double minutesPerMile(int edge) const { return m_minutesPerMile[edge]; }
+      // the smallest minutesPerMile of any edge, to turn crow miles into a
+      // lower bound on the minutes left
+    double fastestMinutesPerMile() const { return m_fastestMinutesPerMile; }
+    double edgeMinutes(int edge) const { return m_graph->edgeLength(edge) * m_minutesPerMile[edge]; }
+
+      // time lost going from edge from onto edge to, which leaves the node
+      // from arrives at
+    double turnMinutes(int from, int to) const
+    {
+        if (m_graph->edgeTarget(to) == m_graph->edgeSource(from))
+            return U_TURN_MINUTES;
+        if (m_graph->edgeNameId(to) == m_graph->edgeNameId(from))
+            return 0;
+        double cross = m_dirX[from] * m_dirY[to] - m_dirY[from] * m_dirX[to];
+        double dot = m_dirX[from] * m_dirX[to] + m_dirY[from] * m_dirY[to];
+        if (dot > 0 && cross < STRAIGHT_SINE && cross > -STRAIGHT_SINE)
+            return 0;
+        return cross > 0 ? LEFT_TURN_MINUTES : RIGHT_TURN_MINUTES;
+    }
+
+      // driving time of a route given as consecutive edges, turns included
+    double routeMinutes(const std::vector<int>& path) const;
+
+    static const double LEFT_TURN_MINUTES;
+    static const double RIGHT_TURN_MINUTES;
+    static const double U_TURN_MINUTES;
+
+      // C++11 syntax for preventing copying and assignment
+    EdgeCosts(const EdgeCosts&) = delete;
+    EdgeCosts& operator=(const EdgeCosts&) = delete;
+
+private:
+    static const double STRAIGHT_SINE; //sine of the largest angle that is no turn
+
+    const StreetGraph* m_graph;
+    std::vector<double> m_minutesPerMile;
+    //unit vector of each edge's direction, longitude east and latitude north
+    std::vector<float> m_dirX;
+    std::vector<float> m_dirY;
+    double m_fastestMinutesPerMile;
+};
+
+#endif // EDGECOSTS_INCLUDED
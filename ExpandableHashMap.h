@@ -2,24 +2,70 @@
 
 // Skeleton for the ExpandableHashMap class template.  You must implement the first six
 // member functions.
+
+#ifndef EXPANDABLEHASHMAP_INCLUDED
+#define EXPANDABLEHASHMAP_INCLUDED
+
 #include <list>
 #include <vector>
+#include <tuple>
 #include <utility>
 
 //for debugging func dump
 #include <iostream>
 using namespace std;
 
-template<typename KeyType, typename ValueType>
+// Default hash functor: calls a free function
+//     unsigned int hasher(const KeyType& key);
+// defined for the key type.  Maps can be given any other functor instead.
+template<typename KeyType>
+struct HasherFunction
+{
+    unsigned int operator()(const KeyType& key) const
+    {
+        unsigned int hasher(const KeyType& key);
+        return hasher(key);
+    }
+};
+
+template<typename KeyType, typename ValueType, typename Hash = HasherFunction<KeyType>>
 class ExpandableHashMap
 {
 public:
-    ExpandableHashMap(double maximumLoadFactor = 0.5);
+    ExpandableHashMap(double maximumLoadFactor = 0.5, const Hash& hash = Hash());
     ~ExpandableHashMap();
     void reset();
     int size() const;
     void associate(const KeyType& key, const ValueType& value);
 
+      // make room for n associations so that inserting them never expands
+    void reserve(int n);
+
+      // These return a pointer to the value for the key and whether it was
+      // newly inserted.  try_emplace constructs the value from args only if
+      // the key is absent; insert_or_assign overwrites an existing value;
+      // emplace constructs the key/value pair from args and keeps it only if
+      // the key is absent.
+    template<typename... Args>
+    pair<ValueType*, bool> try_emplace(const KeyType& key, Args&&... args);
+    template<typename... Args>
+    pair<ValueType*, bool> try_emplace(KeyType&& key, Args&&... args);
+    template<typename M>
+    pair<ValueType*, bool> insert_or_assign(const KeyType& key, M&& value);
+    template<typename M>
+    pair<ValueType*, bool> insert_or_assign(KeyType&& key, M&& value);
+    template<typename... Args>
+    pair<ValueType*, bool> emplace(Args&&... args);
+
+      // remove the association for key; returns false if there was none
+    bool erase(const KeyType& key);
+
+      // return the value for key, inserting a default constructed one if absent
+    ValueType& findOrInsert(const KeyType& key)
+    {
+        return *try_emplace(key).first;
+    }
+
       // for a map that can't be modified, return a pointer to const ValueType
     const ValueType* find(const KeyType& key) const;
 
@@ -32,30 +78,35 @@ public:
       // C++11 syntax for preventing copying and assignment
     ExpandableHashMap(const ExpandableHashMap&) = delete;
     ExpandableHashMap& operator=(const ExpandableHashMap&) = delete;
-    
+
 
 private:
+    typedef std::list<pair<KeyType,ValueType>> Bucket;
+
     double m_nAssociations;
     double m_maxLoadFactor;
+    Hash m_hash;
     int getBucket(const KeyType& key) const;
-    
-    unsigned int hasher(const KeyType& key);
+
+    pair<KeyType,ValueType>* findEntry(const KeyType& key, int bNum);
+    ValueType* insertNode(Bucket& node, int bNum);
     void expand();
-    std::vector<std::list<pair<KeyType,ValueType>>> m_map; //table holds lists of assosiations
+    void rehash(int nBuckets);
+    std::vector<Bucket> m_map; //table holds lists of assosiations
     int m_nBuckets;
-    
+
 };
 
-template<typename KeyType, typename ValueType>
-ExpandableHashMap<KeyType,ValueType>::ExpandableHashMap(double maximumLoadFactor)
-    :m_maxLoadFactor(maximumLoadFactor), m_nBuckets(8)
+template<typename KeyType, typename ValueType, typename Hash>
+ExpandableHashMap<KeyType,ValueType,Hash>::ExpandableHashMap(double maximumLoadFactor, const Hash& hash)
+    :m_nAssociations(0), m_maxLoadFactor(maximumLoadFactor), m_hash(hash), m_nBuckets(8)
 //make hash table with 8 empty buckets
 {
     m_map.resize(8);
 }
 
-template<typename KeyType, typename ValueType>
-ExpandableHashMap<KeyType, ValueType>::~ExpandableHashMap()
+template<typename KeyType, typename ValueType, typename Hash>
+ExpandableHashMap<KeyType,ValueType,Hash>::~ExpandableHashMap()
 //delete dynamically allocated lists
 {
     while (!m_map.empty())
@@ -64,8 +115,8 @@ ExpandableHashMap<KeyType, ValueType>::~ExpandableHashMap()
     }
 }
 
-template<typename KeyType, typename ValueType>
-void ExpandableHashMap<KeyType,ValueType>::reset()
+template<typename KeyType, typename ValueType, typename Hash>
+void ExpandableHashMap<KeyType,ValueType,Hash>::reset()
 //delete everything in hash table and reset it to one with 8 buckets
 {
     //empty the vector to size 0
@@ -77,73 +128,182 @@ void ExpandableHashMap<KeyType,ValueType>::reset()
     m_map.resize(m_nBuckets);
 }
 
-template<typename KeyType, typename ValueType>
-int ExpandableHashMap<KeyType,ValueType>::size() const
+template<typename KeyType, typename ValueType, typename Hash>
+int ExpandableHashMap<KeyType,ValueType,Hash>::size() const
 //count the number of assosiations
 {
     return m_nAssociations;
     //return the sum of the sizes of each list
 }
 
-template<typename KeyType, typename ValueType>
-void ExpandableHashMap<KeyType,ValueType>::associate(const KeyType& key, const ValueType& value)
+template<typename KeyType, typename ValueType, typename Hash>
+void ExpandableHashMap<KeyType,ValueType,Hash>::associate(const KeyType& key, const ValueType& value)
+{
+    insert_or_assign(key, value);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+void ExpandableHashMap<KeyType,ValueType,Hash>::reserve(int n)
+{
+    int nBuckets = m_nBuckets;
+    while (n > m_maxLoadFactor * nBuckets)
+        nBuckets *= 2;
+    if (nBuckets != m_nBuckets)
+        rehash(nBuckets);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+template<typename... Args>
+pair<ValueType*, bool> ExpandableHashMap<KeyType,ValueType,Hash>::try_emplace(const KeyType& key, Args&&... args)
+{
+    int bNum = getBucket(key);
+    pair<KeyType,ValueType>* p = findEntry(key, bNum);
+    if (p != nullptr)
+        return make_pair(&p->second, false);
+    Bucket node;
+    node.emplace_back(piecewise_construct, forward_as_tuple(key), forward_as_tuple(std::forward<Args>(args)...));
+    return make_pair(insertNode(node, bNum), true);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+template<typename... Args>
+pair<ValueType*, bool> ExpandableHashMap<KeyType,ValueType,Hash>::try_emplace(KeyType&& key, Args&&... args)
+{
+    int bNum = getBucket(key);
+    pair<KeyType,ValueType>* p = findEntry(key, bNum);
+    if (p != nullptr)
+        return make_pair(&p->second, false);
+    Bucket node;
+    node.emplace_back(piecewise_construct, forward_as_tuple(std::move(key)), forward_as_tuple(std::forward<Args>(args)...));
+    return make_pair(insertNode(node, bNum), true);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+template<typename M>
+pair<ValueType*, bool> ExpandableHashMap<KeyType,ValueType,Hash>::insert_or_assign(const KeyType& key, M&& value)
+{
+    int bNum = getBucket(key);
+    pair<KeyType,ValueType>* p = findEntry(key, bNum);
+    if (p != nullptr)
+    {
+        //the key already exists, change its value
+        p->second = std::forward<M>(value);
+        return make_pair(&p->second, false);
+    }
+    // If no association currently exists with that key, create new association
+    Bucket node;
+    node.emplace_back(key, std::forward<M>(value));
+    return make_pair(insertNode(node, bNum), true);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+template<typename M>
+pair<ValueType*, bool> ExpandableHashMap<KeyType,ValueType,Hash>::insert_or_assign(KeyType&& key, M&& value)
 {
-    ValueType* v = find(key);
-    //find returns nullptr if no assosiation for given key is found
-    unsigned int bNum = getBucket(key);
-    if (v == nullptr)
+    int bNum = getBucket(key);
+    pair<KeyType,ValueType>* p = findEntry(key, bNum);
+    if (p != nullptr)
     {
-        // If no association currently exists with that key, create new association
-        m_map[bNum].push_back(make_pair(key,value));
-        m_nAssociations++;
+        //the key already exists, change its value
+        p->second = std::forward<M>(value);
+        return make_pair(&p->second, false);
     }
-    else
+    // If no association currently exists with that key, create new association
+    Bucket node;
+    node.emplace_back(std::move(key), std::forward<M>(value));
+    return make_pair(insertNode(node, bNum), true);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+template<typename... Args>
+pair<ValueType*, bool> ExpandableHashMap<KeyType,ValueType,Hash>::emplace(Args&&... args)
+{
+    //build the association in its own list node first; if the key is new the
+    //node is spliced into its bucket without another allocation
+    Bucket node;
+    node.emplace_back(std::forward<Args>(args)...);
+    int bNum = getBucket(node.front().first);
+    pair<KeyType,ValueType>* p = findEntry(node.front().first, bNum);
+    if (p != nullptr)
+        return make_pair(&p->second, false);
+    return make_pair(insertNode(node, bNum), true);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+bool ExpandableHashMap<KeyType,ValueType,Hash>::erase(const KeyType& key)
+{
+    Bucket& bucket = m_map[getBucket(key)];
+    for (auto it = bucket.begin(); it != bucket.end(); it++)
     {
-        for (auto it = m_map[bNum].begin(); it != m_map[bNum].end(); it++)
-            //find the key and change its value
+        if (it->first == key)
         {
-            if (it->first == key)
-            {
-                it->second = value;
-            }
+            bucket.erase(it);
+            m_nAssociations--;
+            return true;
         }
     }
+    return false;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+pair<KeyType,ValueType>* ExpandableHashMap<KeyType,ValueType,Hash>::findEntry(const KeyType& key, int bNum)
+{
+    for (auto it = m_map[bNum].begin(); it != m_map[bNum].end(); it++)
+    {
+        if (it->first == key)
+            return &*it;
+    }
+    return nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+ValueType* ExpandableHashMap<KeyType,ValueType,Hash>::insertNode(Bucket& node, int bNum)
+//move a one element list holding a new association into bucket bNum
+{
+    ValueType* v = &node.front().second;
+    m_map[bNum].splice(m_map[bNum].end(), node);
+    m_nAssociations++;
     double loadFactor = m_nAssociations/m_nBuckets;
     if (loadFactor > m_maxLoadFactor)
         //make sure that load factor doesn't exceed max
         expand();
+    //list nodes are never reallocated, so v is still valid after expanding
+    return v;
 }
 
-template<typename KeyType, typename ValueType>
-void ExpandableHashMap<KeyType,ValueType>::expand()
+template<typename KeyType, typename ValueType, typename Hash>
+void ExpandableHashMap<KeyType,ValueType,Hash>::expand()
 {
-    std::vector<std::list<pair<KeyType,ValueType>>> temp(m_map);
-    int tempBuckets = m_nBuckets;
-    
     //create new hash map with 2x buckets
-    m_map.clear();
-    m_nBuckets *= 2;
-    m_map.resize(m_nBuckets);
-    
-    for (int i = 0; i < tempBuckets; i++)
+    rehash(m_nBuckets * 2);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+void ExpandableHashMap<KeyType,ValueType,Hash>::rehash(int nBuckets)
+{
+    std::vector<Bucket> temp(nBuckets);
+    m_map.swap(temp);
+    m_nBuckets = nBuckets;
+
+    for (size_t i = 0; i < temp.size(); i++)
         //go through old hash map
     {
-        for (auto it = temp[i].begin(); it != temp[i].end(); it++)
-            //rehash into m_map
+        while (!temp[i].empty())
+            //move each list node into its new bucket; nothing is copied or allocated
         {
-            int bNum = getBucket(it->first);
-            m_map[bNum].push_back(pair<KeyType,ValueType>(it->first,it->second));
+            int bNum = getBucket(temp[i].front().first);
+            m_map[bNum].splice(m_map[bNum].end(), temp[i], temp[i].begin());
         }
     }
 }
 
-template<typename KeyType, typename ValueType>
-const ValueType* ExpandableHashMap<KeyType,ValueType>::find(const KeyType& key) const
+template<typename KeyType, typename ValueType, typename Hash>
+const ValueType* ExpandableHashMap<KeyType,ValueType,Hash>::find(const KeyType& key) const
 {
     int bNum = getBucket(key);
     //std::list<pair<KeyType,ValueType>> Bucket = m_map[bNum];
     //typename std::list<Association>::const_iterator it;
-    
+
     //if the list at that bucket is not empty, find the key in the list
     for (auto it = m_map[bNum].begin(); it != m_map[bNum].end(); it++)
     {
@@ -157,10 +317,11 @@ const ValueType* ExpandableHashMap<KeyType,ValueType>::find(const KeyType& key)
     return nullptr;
 }
 
-template<typename KeyType, typename ValueType>
-int ExpandableHashMap<KeyType,ValueType>::getBucket(const KeyType &key) const
+template<typename KeyType, typename ValueType, typename Hash>
+int ExpandableHashMap<KeyType,ValueType,Hash>::getBucket(const KeyType &key) const
 {
-    unsigned int hasher(const KeyType& key);
-    unsigned int h = hasher(key);
+    unsigned int h = m_hash(key);
     return h % m_map.size();
 }
+
+#endif // EXPANDABLEHASHMAP_INCLUDED
@@ -0,0 +1,429 @@
+// FlatHashMap.h
+
+// Open addressing alternative to ExpandableHashMap with the same interface.
+// Associations live in one flat array probed with Robin Hood hashing, and the
+// table size is a power of two so a bucket is picked with a mask instead of %.
+// When the load factor is exceeded a table of twice the size is allocated and
+// the old table is drained a few slots per insertion, so no single call pays
+// for rehashing the whole map.  While that migration is in progress, find
+// looks in the new table first and then in the old one.
+//
+// The hash functor defaults to calling unsigned int hasher(const KeyType&),
+// as ExpandableHashMap's does.  Pointers returned by find and the insertion
+// functions are invalidated by the next insertion.
+
+#ifndef FLATHASHMAP_INCLUDED
+#define FLATHASHMAP_INCLUDED
+
+#include "ExpandableHashMap.h"
+#include <new>
+#include <tuple>
+#include <utility>
+
+template<typename KeyType, typename ValueType, typename Hash = HasherFunction<KeyType>>
+class FlatHashMap
+{
+public:
+    FlatHashMap(double maximumLoadFactor = 0.75, const Hash& hash = Hash());
+    ~FlatHashMap();
+    void reset();
+    int size() const;
+    void associate(const KeyType& key, const ValueType& value);
+
+      // make room for n associations so that inserting them never expands
+    void reserve(int n);
+
+      // Same meaning as in ExpandableHashMap: each returns a pointer to the
+      // value for the key and whether it was newly inserted.
+    template<typename... Args>
+    std::pair<ValueType*, bool> try_emplace(const KeyType& key, Args&&... args);
+    template<typename... Args>
+    std::pair<ValueType*, bool> try_emplace(KeyType&& key, Args&&... args);
+    template<typename M>
+    std::pair<ValueType*, bool> insert_or_assign(const KeyType& key, M&& value);
+    template<typename M>
+    std::pair<ValueType*, bool> insert_or_assign(KeyType&& key, M&& value);
+    template<typename... Args>
+    std::pair<ValueType*, bool> emplace(Args&&... args);
+
+      // remove the association for key; returns false if there was none
+    bool erase(const KeyType& key);
+
+      // return the value for key, inserting a default constructed one if absent
+    ValueType& findOrInsert(const KeyType& key)
+    {
+        return *try_emplace(key).first;
+    }
+
+      // for a map that can't be modified, return a pointer to const ValueType
+    const ValueType* find(const KeyType& key) const;
+
+      // for a modifiable map, return a pointer to modifiable ValueType
+    ValueType* find(const KeyType& key)
+    {
+        return const_cast<ValueType*>(const_cast<const FlatHashMap*>(this)->find(key));
+    }
+
+      // C++11 syntax for preventing copying and assignment
+    FlatHashMap(const FlatHashMap&) = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+private:
+    typedef std::pair<KeyType, ValueType> Entry;
+
+    struct Meta
+    {
+        unsigned int hash;
+        int dist;   //distance from the home slot, -1 if the slot is empty
+        bool moved; //only in the old table: the entry was migrated to the new one
+    };
+
+    struct Table
+    {
+        Meta* meta;
+        Entry* entries;
+        unsigned int capacity; //always a power of two
+        int count;
+    };
+
+    //slots of the old table drained per insertion; enough to finish well
+    //before the new table can reach its own load factor
+    static const unsigned int MIGRATE_PER_CALL = 8;
+
+    Table m_table;
+    Table m_old;          //capacity 0 unless a migration is in progress
+    unsigned int m_migrated; //old slots already drained
+    double m_maxLoadFactor;
+    Hash m_hash;
+
+    unsigned int hashOf(const KeyType& key) const;
+    Entry* locate(const KeyType& key, unsigned int h) const;
+    ValueType* insert(Entry&& entry, unsigned int h);
+    static void allocate(Table& t, unsigned int capacity);
+    static void destroy(Table& t);
+    static int findSlot(const Table& t, const KeyType& key, unsigned int h);
+    static unsigned int insertNew(Table& t, Entry&& entry, unsigned int h);
+    void startExpand(unsigned int capacity);
+    void migrate(unsigned int slots);
+};
+
+template<typename KeyType, typename ValueType, typename Hash>
+FlatHashMap<KeyType,ValueType,Hash>::FlatHashMap(double maximumLoadFactor, const Hash& hash)
+    :m_migrated(0), m_maxLoadFactor(maximumLoadFactor), m_hash(hash)
+//make hash table with 8 empty slots
+{
+    allocate(m_table, 8);
+    m_old.meta = nullptr;
+    m_old.entries = nullptr;
+    m_old.capacity = 0;
+    m_old.count = 0;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+FlatHashMap<KeyType,ValueType,Hash>::~FlatHashMap()
+{
+    destroy(m_table);
+    destroy(m_old);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+void FlatHashMap<KeyType,ValueType,Hash>::reset()
+//delete everything in hash table and reset it to one with 8 slots
+{
+    destroy(m_table);
+    destroy(m_old);
+    m_migrated = 0;
+    allocate(m_table, 8);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+int FlatHashMap<KeyType,ValueType,Hash>::size() const
+{
+    return m_table.count + m_old.count;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+void FlatHashMap<KeyType,ValueType,Hash>::associate(const KeyType& key, const ValueType& value)
+{
+    insert_or_assign(key, value);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+void FlatHashMap<KeyType,ValueType,Hash>::reserve(int n)
+{
+    unsigned int capacity = m_table.capacity;
+    while (n > m_maxLoadFactor * capacity)
+        capacity *= 2;
+    if (capacity == m_table.capacity)
+        return;
+    //an explicit reserve is allowed to rehash everything at once
+    startExpand(capacity);
+    migrate(m_old.capacity);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+template<typename... Args>
+std::pair<ValueType*, bool> FlatHashMap<KeyType,ValueType,Hash>::try_emplace(const KeyType& key, Args&&... args)
+{
+    if (m_old.capacity != 0)
+        migrate(MIGRATE_PER_CALL);
+    unsigned int h = hashOf(key);
+    Entry* e = locate(key, h);
+    if (e != nullptr)
+        return std::make_pair(&e->second, false);
+    return std::make_pair(insert(Entry(std::piecewise_construct, std::forward_as_tuple(key),
+                                       std::forward_as_tuple(std::forward<Args>(args)...)), h), true);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+template<typename... Args>
+std::pair<ValueType*, bool> FlatHashMap<KeyType,ValueType,Hash>::try_emplace(KeyType&& key, Args&&... args)
+{
+    if (m_old.capacity != 0)
+        migrate(MIGRATE_PER_CALL);
+    unsigned int h = hashOf(key);
+    Entry* e = locate(key, h);
+    if (e != nullptr)
+        return std::make_pair(&e->second, false);
+    return std::make_pair(insert(Entry(std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                                       std::forward_as_tuple(std::forward<Args>(args)...)), h), true);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+template<typename M>
+std::pair<ValueType*, bool> FlatHashMap<KeyType,ValueType,Hash>::insert_or_assign(const KeyType& key, M&& value)
+{
+    if (m_old.capacity != 0)
+        migrate(MIGRATE_PER_CALL);
+    unsigned int h = hashOf(key);
+    Entry* e = locate(key, h);
+    if (e != nullptr)
+    {
+        //an entry not migrated yet carries the new value over with it
+        e->second = std::forward<M>(value);
+        return std::make_pair(&e->second, false);
+    }
+    return std::make_pair(insert(Entry(key, std::forward<M>(value)), h), true);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+template<typename M>
+std::pair<ValueType*, bool> FlatHashMap<KeyType,ValueType,Hash>::insert_or_assign(KeyType&& key, M&& value)
+{
+    if (m_old.capacity != 0)
+        migrate(MIGRATE_PER_CALL);
+    unsigned int h = hashOf(key);
+    Entry* e = locate(key, h);
+    if (e != nullptr)
+    {
+        e->second = std::forward<M>(value);
+        return std::make_pair(&e->second, false);
+    }
+    return std::make_pair(insert(Entry(std::move(key), std::forward<M>(value)), h), true);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+template<typename... Args>
+std::pair<ValueType*, bool> FlatHashMap<KeyType,ValueType,Hash>::emplace(Args&&... args)
+{
+    if (m_old.capacity != 0)
+        migrate(MIGRATE_PER_CALL);
+    Entry entry(std::forward<Args>(args)...);
+    unsigned int h = hashOf(entry.first);
+    Entry* e = locate(entry.first, h);
+    if (e != nullptr)
+        return std::make_pair(&e->second, false);
+    return std::make_pair(insert(std::move(entry), h), true);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+bool FlatHashMap<KeyType,ValueType,Hash>::erase(const KeyType& key)
+{
+    //the old table can't shift entries, so finish moving them out first
+    if (m_old.capacity != 0)
+        migrate(m_old.capacity);
+    int slot = findSlot(m_table, key, hashOf(key));
+    if (slot < 0)
+        return false;
+    //backward shift: pull each following displaced entry one slot closer to
+    //home, so no probe sequence is broken and no tombstone is needed
+    unsigned int mask = m_table.capacity - 1;
+    unsigned int pos = slot;
+    m_table.entries[pos].~Entry();
+    for (;;)
+    {
+        unsigned int next = (pos + 1) & mask;
+        Meta& m = m_table.meta[next];
+        if (m.dist <= 0)
+            break;
+        new (&m_table.entries[pos]) Entry(std::move(m_table.entries[next]));
+        m_table.entries[next].~Entry();
+        m_table.meta[pos] = m;
+        m_table.meta[pos].dist--;
+        pos = next;
+    }
+    m_table.meta[pos].dist = -1;
+    m_table.count--;
+    return true;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+const ValueType* FlatHashMap<KeyType,ValueType,Hash>::find(const KeyType& key) const
+{
+    Entry* e = locate(key, hashOf(key));
+    if (e == nullptr)
+        return nullptr;
+    return &e->second;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+unsigned int FlatHashMap<KeyType,ValueType,Hash>::hashOf(const KeyType& key) const
+{
+    //mix the bits so that masking off the low ones still spreads keys well
+    unsigned int h = m_hash(key);
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    h ^= h >> 16;
+    return h;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+typename FlatHashMap<KeyType,ValueType,Hash>::Entry* FlatHashMap<KeyType,ValueType,Hash>::locate(const KeyType& key, unsigned int h) const
+{
+    int slot = findSlot(m_table, key, h);
+    if (slot >= 0)
+        return &m_table.entries[slot];
+    if (m_old.capacity != 0)
+    {
+        slot = findSlot(m_old, key, h);
+        if (slot >= 0)
+            return &m_old.entries[slot];
+    }
+    return nullptr;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+ValueType* FlatHashMap<KeyType,ValueType,Hash>::insert(Entry&& entry, unsigned int h)
+//insert an entry whose key is in neither table
+{
+    //keep room for one more without passing the load factor
+    if (m_table.count + 1 > m_maxLoadFactor * m_table.capacity)
+        startExpand(m_table.capacity * 2);
+    return &m_table.entries[insertNew(m_table, std::move(entry), h)].second;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+void FlatHashMap<KeyType,ValueType,Hash>::allocate(Table& t, unsigned int capacity)
+{
+    t.meta = new Meta[capacity];
+    for (unsigned int i = 0; i < capacity; i++)
+    {
+        t.meta[i].dist = -1;
+        t.meta[i].moved = false;
+    }
+    //entries are constructed only when a slot is filled
+    t.entries = static_cast<Entry*>(::operator new(sizeof(Entry) * capacity));
+    t.capacity = capacity;
+    t.count = 0;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+void FlatHashMap<KeyType,ValueType,Hash>::destroy(Table& t)
+{
+    for (unsigned int i = 0; i < t.capacity; i++)
+    {
+        if (t.meta[i].dist >= 0 && !t.meta[i].moved)
+            t.entries[i].~Entry();
+    }
+    delete [] t.meta;
+    ::operator delete(t.entries);
+    t.meta = nullptr;
+    t.entries = nullptr;
+    t.capacity = 0;
+    t.count = 0;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+int FlatHashMap<KeyType,ValueType,Hash>::findSlot(const Table& t, const KeyType& key, unsigned int h)
+{
+    unsigned int mask = t.capacity - 1;
+    unsigned int pos = h & mask;
+    //an entry is never further from home than the one displacing it, so the
+    //probe can stop at the first slot closer to its home than we are
+    for (int dist = 0; t.meta[pos].dist >= dist; dist++)
+    {
+        if (t.meta[pos].hash == h && !t.meta[pos].moved && t.entries[pos].first == key)
+            return pos;
+        pos = (pos + 1) & mask;
+    }
+    return -1;
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+unsigned int FlatHashMap<KeyType,ValueType,Hash>::insertNew(Table& t, Entry&& entry, unsigned int h)
+//insert an entry known not to be in t, taking slots from entries closer to
+//home; returns the slot the new entry ended up in
+{
+    unsigned int mask = t.capacity - 1;
+    unsigned int pos = h & mask;
+    unsigned int result = t.capacity;
+    Meta carried = { h, 0, false };
+    Entry carriedEntry(std::move(entry));
+    for (;;)
+    {
+        Meta& m = t.meta[pos];
+        if (m.dist < 0)
+        {
+            m = carried;
+            new (&t.entries[pos]) Entry(std::move(carriedEntry));
+            t.count++;
+            return result == t.capacity ? pos : result;
+        }
+        if (m.dist < carried.dist)
+        {
+            std::swap(m, carried);
+            std::swap(t.entries[pos], carriedEntry);
+            if (result == t.capacity)
+                result = pos;
+        }
+        pos = (pos + 1) & mask;
+        carried.dist++;
+    }
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+void FlatHashMap<KeyType,ValueType,Hash>::startExpand(unsigned int capacity)
+{
+    //a previous migration must be complete before the table is replaced again
+    if (m_old.capacity != 0)
+        migrate(m_old.capacity);
+    m_old = m_table;
+    m_migrated = 0;
+    allocate(m_table, capacity);
+}
+
+template<typename KeyType, typename ValueType, typename Hash>
+void FlatHashMap<KeyType,ValueType,Hash>::migrate(unsigned int slots)
+{
+    //the old table is frozen: entries are moved out and flagged, never shifted,
+    //so the probe sequences of the entries still waiting stay intact
+    for (; slots > 0 && m_migrated < m_old.capacity; slots--, m_migrated++)
+    {
+        Meta& m = m_old.meta[m_migrated];
+        if (m.dist < 0 || m.moved)
+            continue;
+        insertNew(m_table, std::move(m_old.entries[m_migrated]), m.hash);
+        m_old.entries[m_migrated].~Entry();
+        m.moved = true;
+        m_old.count--;
+    }
+    if (m_migrated == m_old.capacity)
+    {
+        destroy(m_old);
+        m_migrated = 0;
+    }
+}
+
+#endif // FLATHASHMAP_INCLUDED
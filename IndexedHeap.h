@@ -0,0 +1,126 @@
+// IndexedHeap.h
+
+// Min-priority queue of integer IDs (graph nodes) in [0, capacity) with
+// double keys, stored as a 4-ary heap.  A position array indexed by ID lets
+// a queued ID have its key lowered in place (decrease-key), so each ID is in
+// the heap at most once and searches never pop stale duplicates.
+
+#ifndef INDEXEDHEAP_INCLUDED
+#define INDEXEDHEAP_INCLUDED
+
+#include <vector>
+
+class IndexedHeap
+{
+public:
+    IndexedHeap(int capacity = 0)
+     : m_pos(capacity, -1)
+    {}
+
+      // make room for IDs up to capacity-1; empties the heap
+    void resize(int capacity)
+    {
+        clear();
+        m_pos.assign(capacity, -1);
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < m_heap.size(); i++)
+            m_pos[m_heap[i].id] = -1;
+        m_heap.clear();
+    }
+
+    bool empty() const { return m_heap.empty(); }
+    int size() const { return static_cast<int>(m_heap.size()); }
+    bool contains(int id) const { return m_pos[id] >= 0; }
+    int top() const { return m_heap[0].id; }
+    double topKey() const { return m_heap[0].key; }
+
+      // insert id, or lower its key if it is already queued with a larger one;
+      // returns false if the key was not lowered
+    bool pushOrDecrease(int id, double key)
+    {
+        int i = m_pos[id];
+        if (i < 0)
+        {
+            i = static_cast<int>(m_heap.size());
+            Item item = { key, id };
+            m_heap.push_back(item);
+        }
+        else if (key < m_heap[i].key)
+            m_heap[i].key = key;
+        else
+            return false;
+        siftUp(i, m_heap[i]);
+        return true;
+    }
+
+      // remove and return the ID with the smallest key
+    int pop()
+    {
+        int id = m_heap[0].id;
+        m_pos[id] = -1;
+        Item last = m_heap.back();
+        m_heap.pop_back();
+        if (!m_heap.empty())
+            siftDown(0, last);
+        return id;
+    }
+
+private:
+    struct Item
+    {
+        double key;
+        int id;
+    };
+
+    static const int ARITY = 4;
+
+    std::vector<Item> m_heap;
+    std::vector<int> m_pos; //index of each ID in m_heap, -1 if not queued
+
+    //move the hole at i up until item fits, then place it
+    void siftUp(int i, Item item)
+    {
+        while (i > 0)
+        {
+            int parent = (i - 1) / ARITY;
+            if (!(item.key < m_heap[parent].key))
+                break;
+            m_heap[i] = m_heap[parent];
+            m_pos[m_heap[i].id] = i;
+            i = parent;
+        }
+        m_heap[i] = item;
+        m_pos[item.id] = i;
+    }
+
+    //move the hole at i down until item fits, then place it
+    void siftDown(int i, Item item)
+    {
+        int n = static_cast<int>(m_heap.size());
+        for (;;)
+        {
+            int first = ARITY * i + 1;
+            if (first >= n)
+                break;
+            int last = first + ARITY < n ? first + ARITY : n;
+            int best = first;
+            for (int c = first + 1; c < last; c++)
+            {
+                if (m_heap[c].key < m_heap[best].key)
+                    best = c;
+            }
+            if (!(m_heap[best].key < item.key))
+                break;
+            m_heap[i] = m_heap[best];
+            m_pos[m_heap[i].id] = i;
+            i = best;
+        }
+        m_heap[i] = item;
+        m_pos[item.id] = i;
+    }
+};
+
+#endif // INDEXEDHEAP_INCLUDED
@@ -0,0 +1,194 @@
+#include "provided.h"
+#include "LandmarkIndex.h"
+#include "IndexedHeap.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    const double INFINITE_DISTANCE = numeric_limits<double>::infinity();
+
+    //the edges entering each node, as runs of edge IDs
+    struct ReverseEdges
+    {
+        vector<int> offset;
+        vector<int> edges;
+
+        explicit ReverseEdges(const StreetGraph& graph)
+         : offset(graph.nodeCount() + 1, 0), edges(graph.edgeCount())
+        {
+            for (int e = 0; e < graph.edgeCount(); e++)
+                offset[graph.edgeTarget(e) + 1]++;
+            for (int v = 0; v < graph.nodeCount(); v++)
+                offset[v + 1] += offset[v];
+            vector<int> next(offset.begin(), offset.end() - 1);
+            for (int e = 0; e < graph.edgeCount(); e++)
+                edges[next[graph.edgeTarget(e)]++] = e;
+        }
+    };
+
+    //Dijkstra from source over the edges, or over the reversed edges if
+    //reverse is given, leaving the road distance of every node in dist
+    void shortestDistances(const StreetGraph& graph, const ReverseEdges* reverse, int source,
+                           IndexedHeap& heap, vector<double>& dist)
+    {
+        dist.assign(graph.nodeCount(), INFINITE_DISTANCE);
+        dist[source] = 0;
+        heap.pushOrDecrease(source, 0);
+        while (!heap.empty())
+        {
+            int u = heap.pop();
+            int first = reverse == nullptr ? graph.edgeBegin(u) : reverse->offset[u];
+            int last = reverse == nullptr ? graph.edgeEnd(u) : reverse->offset[u + 1];
+            for (int i = first; i != last; i++)
+            {
+                int e = reverse == nullptr ? i : reverse->edges[i];
+                int v = reverse == nullptr ? graph.edgeTarget(e) : graph.edgeSource(e);
+                double d = dist[u] + graph.baseEdgeLength(e);
+                if (d < dist[v])
+                {
+                    dist[v] = d;
+                    heap.pushOrDecrease(v, d);
+                }
+            }
+        }
+    }
+
+    //the node with the largest distance; nodes that can't be reached at all
+    //count as farthest, so every piece of a disconnected map gets a landmark
+    int farthest(const vector<double>& dist)
+    {
+        return static_cast<int>(max_element(dist.begin(), dist.end()) - dist.begin());
+    }
+}
+
+LandmarkIndex::LandmarkIndex()
+ : m_buildSeconds(0)
+{
+}
+
+void LandmarkIndex::clear()
+{
+    m_landmarks.clear();
+    m_from.clear();
+    m_to.clear();
+    m_buildSeconds = 0;
+}
+
+void LandmarkIndex::build(const StreetGraph& graph, int count, const vector<int>& seeds)
+{
+    auto startTime = chrono::steady_clock::now();
+    clear();
+    int n = graph.nodeCount();
+    if (n == 0 || count <= 0)
+        return;
+    count = min(count, n);
+
+    ReverseEdges reverse(graph);
+    IndexedHeap heap(n);
+    vector<vector<double>> from;
+    vector<vector<double>> to;
+    vector<double> nearest(n, INFINITE_DISTANCE); //distance from the closest landmark so far
+    vector<double> dist;
+    size_t nextSeed = 0;
+    while (static_cast<int>(m_landmarks.size()) < count)
+    {
+        //the next usable seed, or else the node farthest from every landmark
+        int l = -1;
+        while (l < 0 && nextSeed < seeds.size())
+        {
+            int s = seeds[nextSeed++];
+            if (s >= 0 && s < n && find(m_landmarks.begin(), m_landmarks.end(), s) == m_landmarks.end())
+                l = s;
+        }
+        if (l < 0 && m_landmarks.empty())
+        {
+            //no seeds: start from the node farthest from an arbitrary one
+            shortestDistances(graph, nullptr, 0, heap, dist);
+            l = farthest(dist);
+        }
+        else if (l < 0)
+        {
+            l = farthest(nearest);
+            if (find(m_landmarks.begin(), m_landmarks.end(), l) != m_landmarks.end())
+                break; //only nodes right on top of a landmark are left
+        }
+
+        m_landmarks.push_back(l);
+        from.push_back(vector<double>());
+        to.push_back(vector<double>());
+        shortestDistances(graph, nullptr, l, heap, from.back());
+        shortestDistances(graph, &reverse, l, heap, to.back());
+        for (int v = 0; v < n; v++)
+            nearest[v] = min(nearest[v], from.back()[v]);
+    }
+
+    int k = landmarkCount();
+    m_from.resize(static_cast<size_t>(n) * k);
+    m_to.resize(static_cast<size_t>(n) * k);
+    for (int v = 0; v < n; v++)
+    {
+        for (int i = 0; i < k; i++)
+        {
+            m_from[static_cast<size_t>(v) * k + i] = from[i][v];
+            m_to[static_cast<size_t>(v) * k + i] = to[i][v];
+        }
+    }
+    m_buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+double LandmarkIndex::megabytes() const
+{
+    return (m_from.size() + m_to.size()) * sizeof(double) / 1e6;
+}
+
+LandmarkIndex::Heuristic::Heuristic(const LandmarkIndex& index, const StreetGraph& graph, int source, int target)
+ : m_index(index), m_graph(graph), m_target(target), m_activeCount(0)
+{
+    //rank the landmarks by how well they bound the whole trip, and keep the
+    //best in order; an insertion into a fixed array, so no query allocates
+    double bestBounds[ACTIVE_LANDMARKS];
+    for (int i = 0; i < index.landmarkCount(); i++)
+    {
+        //a landmark that reaches neither end gives no bound (NaN)
+        double b1 = index.from(i, target) - index.from(i, source);
+        double b2 = index.to(i, source) - index.to(i, target);
+        double b = b1 == b1 && (b1 >= b2 || b2 != b2) ? b1 : b2;
+        if (b != b || (m_activeCount == ACTIVE_LANDMARKS && !(b > bestBounds[ACTIVE_LANDMARKS - 1])))
+            continue;
+        int k = m_activeCount < ACTIVE_LANDMARKS ? m_activeCount++ : ACTIVE_LANDMARKS - 1;
+        for (; k > 0 && b > bestBounds[k - 1]; k--)
+        {
+            bestBounds[k] = bestBounds[k - 1];
+            m_active[k] = m_active[k - 1];
+        }
+        bestBounds[k] = b;
+        m_active[k] = i;
+    }
+    for (int k = 0; k < m_activeCount; k++)
+    {
+        m_fromToTarget[k] = index.from(m_active[k], target);
+        m_targetTo[k] = index.to(m_active[k], target);
+    }
+}
+
+double LandmarkIndex::Heuristic::operator()(int node) const
+{
+    //every bound here never overestimates and is consistent, so neither does
+    //their maximum; NaN bounds (both sides unreachable) fail the comparisons
+    double h = m_graph.chordMiles(node, m_target);
+    for (int k = 0; k < m_activeCount; k++)
+    {
+        int i = m_active[k];
+        double b = m_fromToTarget[k] - m_index.from(i, node);
+        if (b > h)
+            h = b;
+        b = m_index.to(i, node) - m_targetTo[k];
+        if (b > h)
+            h = b;
+    }
+    return h;
+}
@@ -0,0 +1,75 @@
+// LandmarkIndex.h
+
+// Landmark (ALT) lower bounds for A*.  For a few landmark nodes L the index
+// stores the road distance from L to every node and from every node to L.
+// By the triangle inequality
+//     d(v,t) >= d(L,t) - d(L,v)    and    d(v,t) >= d(v,L) - d(t,L)
+// so any landmark gives a lower bound on the distance left from v to the end,
+// and one that lies behind v or beyond t gives a much tighter bound than the
+// crow-fly distance, for instance when the road has to detour to a bridge.
+//
+// Building the index takes two Dijkstra searches per landmark, so unlike a
+// contraction hierarchy it is cheap to rebuild whenever the map changes.  The
+// distances are by base edge length, so they stay lower bounds through live
+// changes that only lengthen or close edges (see StreetGraph.h).
+
+#ifndef LANDMARKINDEX_INCLUDED
+#define LANDMARKINDEX_INCLUDED
+
+#include "StreetGraph.h"
+#include <vector>
+
+class LandmarkIndex
+{
+public:
+    LandmarkIndex();
+    void clear();
+    bool empty() const { return m_landmarks.empty(); }
+
+      // picks count landmarks: the seeds first (a depot, say), then each next
+      // one as far as possible from those already picked; replaces the index
+    void build(const StreetGraph& graph, int count, const std::vector<int>& seeds);
+
+    int landmarkCount() const { return static_cast<int>(m_landmarks.size()); }
+    int landmark(int i) const { return m_landmarks[i]; }
+    double buildSeconds() const { return m_buildSeconds; }
+    double megabytes() const;
+
+    // Lower bound on the distance from any node to one target.  It uses only
+    // the few landmarks that bound the start-to-target distance best, which
+    // keeps each evaluation cheap without giving up much of the bound.
+    class Heuristic
+    {
+    public:
+        Heuristic(const LandmarkIndex& index, const StreetGraph& graph, int source, int target);
+        double operator()(int node) const;
+    private:
+        static const int ACTIVE_LANDMARKS = 4;
+
+        const LandmarkIndex& m_index;
+        const StreetGraph& m_graph;
+        int m_target;
+        int m_active[ACTIVE_LANDMARKS];
+        double m_fromToTarget[ACTIVE_LANDMARKS]; //d(L,t)
+        double m_targetTo[ACTIVE_LANDMARKS];     //d(t,L)
+        int m_activeCount;
+    };
+
+      // C++11 syntax for preventing copying and assignment
+    LandmarkIndex(const LandmarkIndex&) = delete;
+    LandmarkIndex& operator=(const LandmarkIndex&) = delete;
+
+private:
+    std::vector<int> m_landmarks;
+    //node-major, so the bounds for one node share a cache line:
+    //m_from[v * landmarkCount() + i] = d(landmark i, v), m_to likewise d(v, landmark i);
+    //infinite if there is no path
+    std::vector<double> m_from;
+    std::vector<double> m_to;
+    double m_buildSeconds;
+
+    double from(int i, int node) const { return m_from[static_cast<size_t>(node) * m_landmarks.size() + i]; }
+    double to(int i, int node) const { return m_to[static_cast<size_t>(node) * m_landmarks.size() + i]; }
+};
+
+#endif // LANDMARKINDEX_INCLUDED
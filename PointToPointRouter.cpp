@@ -1,31 +1,99 @@
 #include "provided.h"
 #include <algorithm>
 #include <list>
-#include <set>
 #include <utility>
 #include <vector>
-#include <queue>
-#include "ExpandableHashMap.h"
+#include <limits>
+#include "StreetGraph.h"
+#include "SearchWorkspace.h"
+#include "ContractionHierarchy.h"
+#include "LandmarkIndex.h"
+#include "RouteCache.h"
+#include "EdgeCosts.h"
 using namespace std;
 
+namespace
+{
+    //every segment is at least as long as the crow distance between its ends,
+    //and that is at least the chord, so the chord to the end is a consistent
+    //lower bound; scaled by the fastest minutes per mile, it bounds the
+    //minutes left likewise
+    struct CrowDistance
+    {
+        CrowDistance(const StreetGraph& graph, int target, double scale = 1)
+         : m_graph(graph), m_target(target), m_scale(scale)
+        {}
+        double operator()(int node) const { return m_graph.chordMiles(node, m_target) * m_scale; }
+        const StreetGraph& m_graph;
+        int m_target;
+        double m_scale;
+    };
+
+    //edge weights for the searches, one functor per profile so that the
+    //inner loops inline them
+    struct EdgeMiles
+    {
+        explicit EdgeMiles(const StreetGraph& graph) : m_graph(graph) {}
+        double operator()(int edge) const { return m_graph.edgeLength(edge); }
+        const StreetGraph& m_graph;
+    };
+
+    struct EdgeMinutes
+    {
+        explicit EdgeMinutes(const EdgeCosts& costs) : m_costs(costs) {}
+        double operator()(int edge) const { return m_costs.edgeMinutes(edge); }
+        const EdgeCosts& m_costs;
+    };
+
+    //search state kept per thread, so a query allocates nothing once the
+    //workspaces have grown to the map; bidirectional search uses the first
+    //two, and the turn-aware search, whose states are edges, the third
+    SearchWorkspace& threadWorkspace(int side)
+    {
+        static thread_local SearchWorkspace workspaces[3];
+        return workspaces[side];
+    }
+
+    //the route's edges, likewise reused by every query on a thread
+    vector<int>& threadPath()
+    {
+        static thread_local vector<int> path;
+        return path;
+    }
+}
+
 class PointToPointRouterImpl
 {
 public:
     PointToPointRouterImpl(const StreetMap* sm);
     ~PointToPointRouterImpl();
+    void setSearchMode(RouteSearchMode mode);
+    void setCostProfile(RouteCostProfile profile);
     DeliveryResult generatePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         list<StreetSegment>& route,
-        double& totalDistanceTravelled) const;
+        vector<double>* segmentMiles,
+        double& totalDistanceTravelled,
+        RouteStats& stats) const;
 private:
     const StreetMap* m_sm;
-  
+    RouteSearchMode m_mode;
+    RouteCostProfile m_profile;
+
+    //each search fills path with the edges from source to target, in order;
+    //the search for the router's profile and mode
+    bool search(int source, int target, vector<int>& path, RouteStats& stats) const;
+    //heuristic(v) must be a consistent lower bound on the cost from v to target
+    template<typename Weight, typename Heuristic>
+    bool searchAStar(int source, int target, const Weight& weight, const Heuristic& heuristic, vector<int>& path, RouteStats& stats) const;
+    bool searchBidirectional(int source, int target, vector<int>& path, RouteStats& stats) const;
+    bool searchWithTurns(int source, int target, vector<int>& path, RouteStats& stats) const;
 };
 
 
 PointToPointRouterImpl::PointToPointRouterImpl(const StreetMap* sm)
-    :m_sm(sm)
+    :m_sm(sm), m_mode(SEARCH_ASTAR), m_profile(COST_DISTANCE)
 {
 }
 
@@ -33,83 +101,280 @@ PointToPointRouterImpl::~PointToPointRouterImpl()
 {
 }
 
-unsigned int hasher(const pair<GeoCoord,GeoCoord>& g)
+void PointToPointRouterImpl::setSearchMode(RouteSearchMode mode)
 {
-    return std::hash<string>()(g.first.latitudeText + g.first.longitudeText);
+    m_mode = mode;
+}
+
+void PointToPointRouterImpl::setCostProfile(RouteCostProfile profile)
+{
+    m_profile = profile;
 }
 
 DeliveryResult PointToPointRouterImpl::generatePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         list<StreetSegment>& route,
-        double& totalDistanceTravelled) const
+        vector<double>* segmentMiles,
+        double& totalDistanceTravelled,
+        RouteStats& stats) const
 {
-    typedef pair<double,GeoCoord> node;
-    vector<StreetSegment> temp, temp2;
-    priority_queue<node,vector<node>,greater<node>> nodeQueue; //will be sorted by the double
-    ExpandableHashMap<GeoCoord, GeoCoord> m_path;
-    ExpandableHashMap<pair<GeoCoord,GeoCoord>, string> m_pathNames;
-    set<GeoCoord> closedSet;
+    const StreetGraph& graph = *m_sm->graph();
+    stats = RouteStats();
     
     if (!route.empty())
         route.clear();
+    if (segmentMiles != nullptr)
+        segmentMiles->clear();
     
     //make sure that the start and end coordinates exist in the map data
-    m_sm->getSegmentsThatStartWith(start, temp);
-    m_sm->getSegmentsThatStartWith(end, temp2);
-    if (temp.empty() || temp2.empty())
+    int source = graph.nodeId(start);
+    int target = graph.nodeId(end);
+    if (source < 0 || target < 0)
         return BAD_COORD;
     
+    //every search mode finds a cheapest route for the profile, so they
+    //share cached ones
+    const EdgeCosts& costs = *m_sm->edgeCosts();
+    RouteKey key = { source, target, m_profile };
+    RouteCache* cache = m_sm->routeCache();
+    vector<int>& path = threadPath();
+    path.clear();
+    double distance = 0;
+    bool found;
+    stats.cacheHit = cache->lookup(key, path, distance, found);
+    if (!stats.cacheHit)
+    {
+        found = search(source, target, path, stats);
+        for (size_t i = 0; i < path.size(); i++)
+            distance += graph.edgeLength(path[i]);
+        cache->store(key, path, distance, found);
+    }
+    if (!found)
+        return NO_ROUTE;
     
-    nodeQueue.push(make_pair(0,start)); //start has initial "fval" of 0
+    //turn the edges into segments; a cached route is only kept while its
+    //edges' live lengths are the ones it was found with, so they add up to
+    //its distance either way
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        route.push_back(graph.segment(path[i]));
+        if (segmentMiles != nullptr)
+            segmentMiles->push_back(graph.edgeLength(path[i]));
+    }
+    totalDistanceTravelled = distance;
+    stats.minutes = costs.routeMinutes(path);
+    return DELIVERY_SUCCESS;
+}
+
+bool PointToPointRouterImpl::search(int source, int target, vector<int>& path, RouteStats& stats) const
+{
+    const StreetGraph& graph = *m_sm->graph();
+    const EdgeCosts& costs = *m_sm->edgeCosts();
+    if (m_profile == COST_TIME)
+        return searchAStar(source, target, EdgeMinutes(costs), CrowDistance(graph, target, costs.fastestMinutesPerMile()), path, stats);
+    if (m_profile == COST_TURNS)
+        return searchWithTurns(source, target, path, stats);
+
+    //the hierarchy and landmarks are built on the base lengths, which
+    //bound the live ones from below unless some edge got shorter
+    bool baseIsLowerBound = graph.shortenedEdges() == 0;
+    const ContractionHierarchy* hierarchy = m_sm->hierarchy();
+    if (m_mode == SEARCH_CH && hierarchy != nullptr && baseIsLowerBound)
+    {
+        bool found = hierarchy->findPath(source, target, path, stats);
+        //a base shortest path is still shortest if none of its edges
+        //changed; otherwise search the live lengths directly
+        if (none_of(path.begin(), path.end(), [&](int e) { return graph.edgeModified(e); }))
+            return found;
+        path.clear();
+        return searchBidirectional(source, target, path, stats);
+    }
+    if (m_mode == SEARCH_BIDIRECTIONAL)
+        return searchBidirectional(source, target, path, stats);
+    if (m_mode == SEARCH_ALT && m_sm->landmarks() != nullptr && baseIsLowerBound)
+        return searchAStar(source, target, EdgeMiles(graph), LandmarkIndex::Heuristic(*m_sm->landmarks(), graph, source, target), path, stats);
+    return searchAStar(source, target, EdgeMiles(graph), CrowDistance(graph, target), path, stats);
+}
+
+template<typename Weight, typename Heuristic>
+bool PointToPointRouterImpl::searchAStar(int source, int target, const Weight& weight, const Heuristic& heuristic, vector<int>& path, RouteStats& stats) const
+{
+    const StreetGraph& graph = *m_sm->graph();
+    //per node: cheapest known cost from the start (g), the edge used to
+    //reach it, and whether its cost is final; the heap is ordered by g + h
+    SearchWorkspace& ws = threadWorkspace(0);
+    ws.start(graph.nodeCount());
+    
+    //A*: the heuristic never overestimates the cost left and never drops by
+    //more than the weight of a segment, so a node's cost is final once it is
+    //popped
+    ws.reach(source, 0, -1);
+    ws.heap.pushOrDecrease(source, heuristic(source));
     
-    while (!nodeQueue.empty())
+    while (!ws.heap.empty())
     {
-        //take coord from top of queue
-        GeoCoord current = nodeQueue.top().second;
-        nodeQueue.pop();
+        //take the node with the smallest estimated total from the queue
+        int current = ws.heap.pop();
+        ws.settle(current);
+        stats.nodesSettled++;
         
-        if (current == end) //if we have reached the end
+        if (current == target) //if we have reached the end
         {
             //retrace steps
-            GeoCoord retracer = end;
-            totalDistanceTravelled = 0;
-            while (retracer != start)
-                //loop through until we reach the start
+            for (int n = target; n != source; n = graph.edgeSource(ws.parentEdge(n)))
+                path.push_back(ws.parentEdge(n));
+            reverse(path.begin(), path.end());
+            return true;
+        }
+        
+        //if we haven't reached the end, relax the adjacent segments
+        double g = ws.distance(current);
+        for (int e : graph.edges(current))
+        {
+            int neighbor = graph.edgeTarget(e);
+            if (ws.settled(neighbor))
+                //if the neighbor's distance is already final
+                continue;
+            stats.edgesRelaxed++;
+            double d = g + weight(e);
+            if (d < ws.distance(neighbor))
             {
-                GeoCoord* s = m_path.find(retracer);
-                string* streetName;
-                streetName = m_pathNames.find(make_pair(*s, retracer));
-                StreetSegment seg(*s,retracer,*streetName);
-                route.push_front(seg);
-                totalDistanceTravelled += distanceEarthMiles(seg.start, seg.end);
-                retracer = *s;
+                //found a cheaper way to the neighbor, queue or reprioritize it
+                ws.reach(neighbor, d, e);
+                ws.heap.pushOrDecrease(neighbor, d + heuristic(neighbor));
             }
-            return DELIVERY_SUCCESS;
         }
-        //if we haven't reached the end, get neighbors
-        vector<StreetSegment> neighbors;
-        m_sm->getSegmentsThatStartWith(current, neighbors);
+    }
+    
+    return false;
+}
+
+bool PointToPointRouterImpl::searchBidirectional(int source, int target, vector<int>& path, RouteStats& stats) const
+{
+    //Searches forward from the start and backward from the end at the same
+    //time.  The backward search follows the reverse of every segment, which
+    //load() always stores alongside the forward one.  Both use the average
+    //potential p(v) = (chord(v,end) - chord(v,start)) / 2, forward keys g + p
+    //and backward keys g - p; with it both searches see the same nonnegative
+    //reduced lengths, so the best path is final once the two smallest keys
+    //add up to at least the best meeting distance found.
+    const StreetGraph& graph = *m_sm->graph();
+    const double infinity = numeric_limits<double>::infinity();
+    SearchWorkspace* ws[2] = { &threadWorkspace(0), &threadWorkspace(1) };
+    ws[0]->start(graph.nodeCount());
+    ws[1]->start(graph.nodeCount());
+    
+    double best = source == target ? 0 : infinity; //shortest start-to-end distance found so far
+    int meeting = source == target ? source : -1;
+    ws[0]->reach(source, 0, -1);
+    ws[1]->reach(target, 0, -1);
+    //p(start) = chord / 2 and -p(end) = chord / 2
+    ws[0]->heap.pushOrDecrease(source, graph.chordMiles(source, target) / 2);
+    ws[1]->heap.pushOrDecrease(target, graph.chordMiles(source, target) / 2);
+    
+    //when either side runs out of nodes, nothing more can connect the two
+    while (!ws[0]->heap.empty() && !ws[1]->heap.empty())
+    {
+        if (ws[0]->heap.topKey() + ws[1]->heap.topKey() >= best)
+            break;
+        //expand the side with the smaller frontier
+        int side = ws[0]->heap.size() <= ws[1]->heap.size() ? 0 : 1;
+        SearchWorkspace& here = *ws[side];
+        SearchWorkspace& there = *ws[1 - side];
+        int current = here.heap.pop();
+        here.settle(current);
+        stats.nodesSettled++;
         
-        //for all adjacent segments
-        for (int i = 0; i < neighbors.size(); i++)
+        double g = here.distance(current);
+        for (int e : graph.edges(current))
         {
-            if (closedSet.find(neighbors[i].end) != closedSet.end())
-                //if the neighbor exists in closed set
-                //set::find returns iterator == set::end() if it is not found
+            int neighbor = graph.edgeTarget(e);
+            if (here.settled(neighbor))
                 continue;
-            m_path.associate(neighbors[i].end, neighbors[i].start);
-            m_pathNames.associate(make_pair(neighbors[i].start, neighbors[i].end), neighbors[i].name);
-            closedSet.insert(neighbors[i].end); //add to set of coords already visited
-            
-            //set the second value in pair, which is the distance to the end
-            //priority queue will be sorted by this (smallest first)
-            double d = distanceEarthMiles(neighbors[i].end, end);
-            nodeQueue.push(make_pair(d, neighbors[i].end));
+            stats.edgesRelaxed++;
+            double d = g + graph.edgeLength(e);
+            if (d < here.distance(neighbor))
+            {
+                here.reach(neighbor, d, e);
+                double p = (graph.chordMiles(neighbor, target) - graph.chordMiles(neighbor, source)) / 2;
+                here.heap.pushOrDecrease(neighbor, side == 0 ? d + p : d - p);
+                //a node reached from both sides joins a start-to-end path
+                if (d + there.distance(neighbor) < best)
+                {
+                    best = d + there.distance(neighbor);
+                    meeting = neighbor;
+                }
+            }
         }
     }
+    if (meeting < 0)
+        return false;
     
-    return NO_ROUTE;
+    //retrace the forward half, then follow the backward half to the end
+    for (int v = meeting; v != source; v = graph.edgeSource(ws[0]->parentEdge(v)))
+        path.push_back(ws[0]->parentEdge(v));
+    reverse(path.begin(), path.end());
+    for (int v = meeting; v != target; v = graph.edgeSource(ws[1]->parentEdge(v)))
+        //the backward search reached v over the reverse of the segment we drive
+        path.push_back(graph.reverseEdge(ws[1]->parentEdge(v)));
+    return true;
+}
+
+bool PointToPointRouterImpl::searchWithTurns(int source, int target, vector<int>& path, RouteStats& stats) const
+{
+    //What a turn costs depends on the edge a node was reached over, so this
+    //A* settles edges instead of nodes: the state "arrived over e" costs the
+    //minutes to drive the route up to the end of e, and moving on over f
+    //adds f's minutes and the turn from e onto f.  The crow bound on minutes
+    //ignores turns, which only ever add, so it stays consistent.
+    if (source == target)
+        return true;
+    const StreetGraph& graph = *m_sm->graph();
+    const EdgeCosts& costs = *m_sm->edgeCosts();
+    CrowDistance heuristic(graph, target, costs.fastestMinutesPerMile());
+    SearchWorkspace& ws = threadWorkspace(2);
+    ws.start(graph.edgeCount());
+
+    for (int e : graph.edges(source))
+    {
+        double d = costs.edgeMinutes(e);
+        if (d < ws.distance(e))
+        {
+            ws.reach(e, d, -1);
+            ws.heap.pushOrDecrease(e, d + heuristic(graph.edgeTarget(e)));
+        }
+    }
+    while (!ws.heap.empty())
+    {
+        int current = ws.heap.pop();
+        ws.settle(current);
+        stats.nodesSettled++;
+        int at = graph.edgeTarget(current);
+        if (at == target)
+        {
+            //each state's parent is the edge driven before it
+            for (int e = current; e >= 0; e = ws.parentEdge(e))
+                path.push_back(e);
+            reverse(path.begin(), path.end());
+            return true;
+        }
+
+        double g = ws.distance(current);
+        for (int e : graph.edges(at))
+        {
+            if (ws.settled(e))
+                continue;
+            stats.edgesRelaxed++;
+            double d = g + costs.edgeMinutes(e) + costs.turnMinutes(current, e);
+            if (d < ws.distance(e))
+            {
+                ws.reach(e, d, current);
+                ws.heap.pushOrDecrease(e, d + heuristic(graph.edgeTarget(e)));
+            }
+        }
+    }
+    return false;
 }
 
 //******************** PointToPointRouter functions ***************************
@@ -127,11 +392,43 @@ PointToPointRouter::~PointToPointRouter()
     delete m_impl;
 }
 
+void PointToPointRouter::setSearchMode(RouteSearchMode mode)
+{
+    m_impl->setSearchMode(mode);
+}
+
+void PointToPointRouter::setCostProfile(RouteCostProfile profile)
+{
+    m_impl->setCostProfile(profile);
+}
+
 DeliveryResult PointToPointRouter::generatePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         list<StreetSegment>& route,
         double& totalDistanceTravelled) const
 {
-    return m_impl->generatePointToPointRoute(start, end, route, totalDistanceTravelled);
+    RouteStats stats;
+    return m_impl->generatePointToPointRoute(start, end, route, nullptr, totalDistanceTravelled, stats);
+}
+
+DeliveryResult PointToPointRouter::generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        list<StreetSegment>& route,
+        double& totalDistanceTravelled,
+        RouteStats& stats) const
+{
+    return m_impl->generatePointToPointRoute(start, end, route, nullptr, totalDistanceTravelled, stats);
+}
+
+DeliveryResult PointToPointRouter::generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        list<StreetSegment>& route,
+        vector<double>& segmentMiles,
+        double& totalDistanceTravelled,
+        RouteStats& stats) const
+{
+    return m_impl->generatePointToPointRoute(start, end, route, &segmentMiles, totalDistanceTravelled, stats);
 }
@@ -0,0 +1,210 @@
+#include "provided.h"
+#include "RouteCache.h"
+#include <iterator>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    //bookkeeping per cached route beyond its steps: the list node, the index
+    //slot and the vectors' own headers
+    const size_t ROUTE_OVERHEAD = 128;
+}
+
+bool operator==(const RouteKey& lhs, const RouteKey& rhs)
+{
+    return lhs.source == rhs.source && lhs.target == rhs.target && lhs.profile == rhs.profile;
+}
+
+unsigned int RouteKeyHash::operator()(const RouteKey& k) const
+{
+    unsigned int h = static_cast<unsigned int>(k.source) * 0x9E3779B1U;
+    h = (h ^ static_cast<unsigned int>(k.target)) * 0x85EBCA77U;
+    h = (h ^ static_cast<unsigned int>(k.profile)) * 0xC2B2AE3DU;
+    return h ^ (h >> 15);
+}
+
+RouteCache::RouteCache(const StreetGraph& graph, double budgetMegabytes)
+ : m_graph(graph), m_shardBudget(0)
+{
+    for (int i = 0; i < SHARD_COUNT; i++)
+    {
+        m_shards[i].bytes = 0;
+        m_shards[i].hits = 0;
+        m_shards[i].misses = 0;
+        m_shards[i].evictions = 0;
+        m_shards[i].invalidations = 0;
+    }
+    setBudget(budgetMegabytes);
+}
+
+void RouteCache::setBudget(double megabytes)
+{
+    m_shardBudget = megabytes > 0 ? static_cast<size_t>(megabytes * 1e6 / SHARD_COUNT) : 0;
+    for (int i = 0; i < SHARD_COUNT; i++)
+    {
+        lock_guard<mutex> guard(m_shards[i].lock);
+        evict(m_shards[i], m_shardBudget);
+    }
+}
+
+void RouteCache::clear()
+{
+    for (int i = 0; i < SHARD_COUNT; i++)
+    {
+        lock_guard<mutex> guard(m_shards[i].lock);
+        m_shards[i].routes.clear();
+        m_shards[i].index.reset();
+        m_shards[i].bytes = 0;
+    }
+}
+
+bool RouteCache::lookup(const RouteKey& key, vector<int>& path, double& distance, bool& found)
+{
+    Shard& shard = shardFor(key);
+    lock_guard<mutex> guard(shard.lock);
+    RouteList::iterator* it = shard.index.find(key);
+    if (it == nullptr)
+    {
+        shard.misses++;
+        return false;
+    }
+    const Route& route = **it;
+    decode(route, path);
+    if (!current(route, path))
+    {
+        path.clear();
+        remove(shard, *it);
+        shard.invalidations++;
+        shard.misses++;
+        return false;
+    }
+    //move it to the front of the LRU list; list iterators stay valid
+    shard.routes.splice(shard.routes.begin(), shard.routes, *it);
+    shard.hits++;
+    distance = route.distance;
+    found = route.found;
+    return true;
+}
+
+void RouteCache::store(const RouteKey& key, const vector<int>& path, double distance, bool found)
+{
+    size_t budget = m_shardBudget;
+    if (budget == 0)
+        return; //the cache is off; don't even encode the route
+    Route route;
+    route.key = key;
+    route.version = m_graph.version();
+    route.distance = distance;
+    route.found = found;
+    encode(path, route);
+    route.bytes = ROUTE_OVERHEAD + route.steps.size() + route.wideEdges.size() * sizeof(int);
+    if (route.bytes > budget)
+        return;
+
+    Shard& shard = shardFor(key);
+    lock_guard<mutex> guard(shard.lock);
+    if (shard.index.find(key) != nullptr)
+        return; //another thread stored the same leg first
+    shard.routes.push_front(std::move(route));
+    shard.index.associate(key, shard.routes.begin());
+    shard.bytes += shard.routes.front().bytes;
+    evict(shard, budget);
+}
+
+RouteCacheStats RouteCache::stats() const
+{
+    RouteCacheStats s;
+    for (int i = 0; i < SHARD_COUNT; i++)
+    {
+        const Shard& shard = m_shards[i];
+        lock_guard<mutex> guard(shard.lock);
+        s.hits += shard.hits;
+        s.misses += shard.misses;
+        s.evictions += shard.evictions;
+        s.invalidations += shard.invalidations;
+        s.routes += static_cast<int>(shard.routes.size());
+        s.megabytes += shard.bytes / 1e6;
+    }
+    s.budgetMegabytes = static_cast<double>(m_shardBudget) * SHARD_COUNT / 1e6;
+    return s;
+}
+
+RouteCache::Shard& RouteCache::shardFor(const RouteKey& key)
+{
+    //the top four bits pick one of the 16 shards, since the shard's own
+    //table indexes with the low ones
+    return m_shards[RouteKeyHash()(key) >> 28];
+}
+
+void RouteCache::encode(const vector<int>& path, Route& route) const
+{
+    route.firstEdge = path.empty() ? -1 : path[0];
+    if (path.size() > 1)
+        route.steps.reserve(path.size() - 1);
+    for (size_t i = 1; i < path.size(); i++)
+    {
+        //each edge leaves the node the previous one arrives at
+        int step = path[i] - m_graph.edgeBegin(m_graph.edgeTarget(path[i - 1]));
+        if (step < 0 || step > 255)
+        {
+            route.steps.clear();
+            route.wideEdges = path;
+            return;
+        }
+        route.steps.push_back(static_cast<unsigned char>(step));
+    }
+}
+
+void RouteCache::decode(const Route& route, vector<int>& path) const
+{
+    path.clear();
+    if (!route.wideEdges.empty())
+    {
+        path = route.wideEdges;
+        return;
+    }
+    if (route.firstEdge < 0)
+        return;
+    int e = route.firstEdge;
+    path.reserve(route.steps.size() + 1);
+    path.push_back(e);
+    for (size_t i = 0; i < route.steps.size(); i++)
+    {
+        e = m_graph.edgeBegin(m_graph.edgeTarget(e)) + route.steps[i];
+        path.push_back(e);
+    }
+}
+
+bool RouteCache::current(const Route& route, const vector<int>& path) const
+{
+    if (route.version == m_graph.version())
+        return true;
+    //a shorter edge anywhere could make a shorter route, or any route at all
+    if (m_graph.shortenedVersion() > route.version)
+        return false;
+    //otherwise every other route only got longer, so this one is still
+    //shortest unless its own edges changed
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        if (m_graph.edgeVersion(path[i]) > route.version)
+            return false;
+    }
+    return true;
+}
+
+void RouteCache::remove(Shard& shard, RouteList::iterator it)
+{
+    shard.bytes -= it->bytes;
+    shard.index.erase(it->key);
+    shard.routes.erase(it);
+}
+
+void RouteCache::evict(Shard& shard, size_t budget)
+{
+    while (shard.bytes > budget && !shard.routes.empty())
+    {
+        remove(shard, prev(shard.routes.end()));
+        shard.evictions++;
+    }
+}
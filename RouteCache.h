@@ -0,0 +1,110 @@
+// RouteCache.h
+
+// Bounded, thread-safe cache of point-to-point routes, shared by every router
+// on one StreetMap.  Routes are keyed by start node, end node and cost
+// profile, and kept compact: the first edge ID, then for each later edge its
+// position among the edges leaving the node before it, which for street maps
+// fits in a byte.  When the memory budget is reached the least recently used
+// routes are evicted.
+//
+// The cache is split into shards, each with its own lock, LRU list and share
+// of the budget, so threads looking up different legs rarely wait on each
+// other.  Failed searches are cached too, so a leg that has no route stays
+// cheap to ask about.
+//
+// Each route remembers the graph version it was found at.  Live changes to
+// the edge lengths don't touch the cache; a lookup instead drops a route that
+// one of them may have made wrong (see StreetGraph.h), so an update costs
+// nothing here however many routes are cached.
+
+#ifndef ROUTECACHE_INCLUDED
+#define ROUTECACHE_INCLUDED
+
+#include "provided.h"
+#include "StreetGraph.h"
+#include "FlatHashMap.h"
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <vector>
+
+struct RouteKey
+{
+    int source;
+    int target;
+    int profile;
+};
+
+bool operator==(const RouteKey& lhs, const RouteKey& rhs);
+
+struct RouteKeyHash
+{
+    unsigned int operator()(const RouteKey& k) const;
+};
+
+class RouteCache
+{
+public:
+    RouteCache(const StreetGraph& graph, double budgetMegabytes);
+
+      // the budget is split evenly between the shards; 0 turns the cache off
+    void setBudget(double megabytes);
+      // drops every route, as when the map they were found on is replaced;
+      // the counters are kept
+    void clear();
+
+      // if the route for key is cached and still right for the graph as it
+      // is now, fills path with its edges and returns true; found is false if
+      // the cached answer is that there is no route
+    bool lookup(const RouteKey& key, std::vector<int>& path, double& distance, bool& found);
+    void store(const RouteKey& key, const std::vector<int>& path, double distance, bool found);
+
+    RouteCacheStats stats() const;
+
+      // C++11 syntax for preventing copying and assignment
+    RouteCache(const RouteCache&) = delete;
+    RouteCache& operator=(const RouteCache&) = delete;
+
+private:
+    struct Route
+    {
+        RouteKey key;
+        unsigned version; //the graph's when the route was found
+        double distance;
+        bool found;
+        int firstEdge;                    //-1 if the route has no edges
+        std::vector<unsigned char> steps; //position of each later edge in its node's run,
+        std::vector<int> wideEdges;       //or, if one doesn't fit in a byte, every edge ID
+        std::size_t bytes;
+    };
+
+    typedef std::list<Route> RouteList;
+
+    struct Shard
+    {
+        mutable std::mutex lock;
+        RouteList routes; //most recently used first
+        FlatHashMap<RouteKey, RouteList::iterator, RouteKeyHash> index;
+        std::size_t bytes;
+        long long hits;
+        long long misses;
+        long long evictions;
+        long long invalidations;
+    };
+
+    static const int SHARD_COUNT = 16;
+
+    const StreetGraph& m_graph;
+    Shard m_shards[SHARD_COUNT];
+    std::atomic<std::size_t> m_shardBudget;
+
+    Shard& shardFor(const RouteKey& key);
+    void encode(const std::vector<int>& path, Route& route) const;
+    void decode(const Route& route, std::vector<int>& path) const;
+    bool current(const Route& route, const std::vector<int>& path) const;
+    static void remove(Shard& shard, RouteList::iterator it);
+    static void evict(Shard& shard, std::size_t budget);
+};
+
+#endif // ROUTECACHE_INCLUDED
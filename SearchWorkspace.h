@@ -0,0 +1,85 @@
+// SearchWorkspace.h
+
+// Per-node state for one shortest path search (distance from the start, the
+// edge it was reached over, whether it is settled) plus the search's heap,
+// kept between searches so that a search allocates nothing once the
+// workspace has grown to the map's size.  Each node's entry carries the
+// generation it was last written in; starting a search just bumps the
+// generation, so every entry from an earlier search reads as untouched
+// without clearing the arrays.
+//
+// A workspace is used by one search at a time; routers keep one per thread
+// (see threadWorkspace in PointToPointRouter.cpp).
+
+#ifndef SEARCHWORKSPACE_INCLUDED
+#define SEARCHWORKSPACE_INCLUDED
+
+#include "IndexedHeap.h"
+#include <limits>
+#include <vector>
+
+class SearchWorkspace
+{
+public:
+    SearchWorkspace()
+     : m_generation(0)
+    {}
+
+      // forget the last search, for a map with nodeCount nodes
+    void start(int nodeCount)
+    {
+        if (static_cast<int>(m_nodes.size()) != nodeCount)
+        {
+            m_nodes.assign(nodeCount, Node());
+            m_generation = 0;
+            heap.resize(nodeCount);
+        }
+        else
+            heap.clear();
+        if (++m_generation == 0)
+        {
+            //the counter wrapped, so old stamps could look current again
+            for (size_t i = 0; i < m_nodes.size(); i++)
+                m_nodes[i].generation = 0;
+            m_generation = 1;
+        }
+    }
+
+      // infinity for nodes this search hasn't reached
+    double distance(int node) const { return touched(node) ? m_nodes[node].distance : std::numeric_limits<double>::infinity(); }
+    int parentEdge(int node) const { return touched(node) ? m_nodes[node].parentEdge : -1; }
+    bool settled(int node) const { return touched(node) && m_nodes[node].settled; }
+
+    void reach(int node, double distance, int parentEdge)
+    {
+        Node& n = m_nodes[node];
+        if (n.generation != m_generation)
+        {
+            n.generation = m_generation;
+            n.settled = false;
+        }
+        n.distance = distance;
+        n.parentEdge = parentEdge;
+    }
+      // only for nodes already reached
+    void settle(int node) { m_nodes[node].settled = true; }
+
+    IndexedHeap heap;
+
+private:
+    struct Node
+    {
+        Node() : distance(0), parentEdge(-1), generation(0), settled(false) {}
+        double distance;
+        int parentEdge;
+        unsigned generation;
+        bool settled;
+    };
+
+    std::vector<Node> m_nodes;
+    unsigned m_generation;
+
+    bool touched(int node) const { return m_nodes[node].generation == m_generation; }
+};
+
+#endif // SEARCHWORKSPACE_INCLUDED
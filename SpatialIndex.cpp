@@ -0,0 +1,296 @@
+#include "provided.h"
+#include "SpatialIndex.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    //children per box
+    const int NODE_SIZE = 16;
+    //queries per task when snapping a batch
+    const int BATCH_CHUNK = 256;
+
+    //position of (x, y), each in [0, 65536), along a Hilbert curve over that square
+    uint64_t hilbert(unsigned x, unsigned y)
+    {
+        const unsigned n = 1u << 16;
+        uint64_t d = 0;
+        for (unsigned s = n / 2; s > 0; s /= 2)
+        {
+            unsigned rx = (x & s) != 0;
+            unsigned ry = (y & s) != 0;
+            d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+            //rotate the quadrant so the curve inside it runs the same way
+            if (ry == 0)
+            {
+                if (rx == 1)
+                {
+                    x = n - 1 - x;
+                    y = n - 1 - y;
+                }
+                swap(x, y);
+            }
+        }
+        return d;
+    }
+
+    //the order that visits points along a Hilbert curve over their bounds
+    vector<int> hilbertOrder(const vector<double>& xs, const vector<double>& ys)
+    {
+        size_t n = xs.size();
+        double minX = numeric_limits<double>::infinity();
+        double minY = minX;
+        double maxX = -minX;
+        double maxY = -minX;
+        for (size_t i = 0; i < n; i++)
+        {
+            minX = min(minX, xs[i]);
+            maxX = max(maxX, xs[i]);
+            minY = min(minY, ys[i]);
+            maxY = max(maxY, ys[i]);
+        }
+        double scaleX = maxX > minX ? 65535 / (maxX - minX) : 0;
+        double scaleY = maxY > minY ? 65535 / (maxY - minY) : 0;
+        vector<pair<uint64_t, int>> keys(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            unsigned hx = static_cast<unsigned>((xs[i] - minX) * scaleX);
+            unsigned hy = static_cast<unsigned>((ys[i] - minY) * scaleY);
+            keys[i] = make_pair(hilbert(hx, hy), static_cast<int>(i));
+        }
+        sort(keys.begin(), keys.end());
+        vector<int> order(n);
+        for (size_t i = 0; i < n; i++)
+            order[i] = keys[i].second;
+        return order;
+    }
+}
+
+void SpatialIndex::Tree::build(vector<Box>& items, vector<int>& itemIds)
+{
+    boxes.clear();
+    ids.clear();
+    levelStart.clear();
+    int n = static_cast<int>(items.size());
+    if (n == 0)
+        return;
+
+    vector<double> cx(n);
+    vector<double> cy(n);
+    for (int i = 0; i < n; i++)
+    {
+        cx[i] = (items[i].minX + items[i].maxX) / 2;
+        cy[i] = (items[i].minY + items[i].maxY) / 2;
+    }
+    vector<int> order = hilbertOrder(cx, cy);
+    boxes.reserve(n + n / (NODE_SIZE - 1) + 2);
+    ids.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        boxes.push_back(items[order[i]]);
+        ids[i] = itemIds[order[i]];
+    }
+
+    //each level boxes up runs of NODE_SIZE boxes of the one below, until one
+    //box (the root) covers everything; even one item gets a root above it
+    levelStart.push_back(0);
+    int first = 0;
+    int last = n;
+    do
+    {
+        levelStart.push_back(last);
+        for (int i = first; i < last; i += NODE_SIZE)
+        {
+            Box b = boxes[i];
+            for (int c = i + 1; c < min(i + NODE_SIZE, last); c++)
+            {
+                b.minX = min(b.minX, boxes[c].minX);
+                b.minY = min(b.minY, boxes[c].minY);
+                b.maxX = max(b.maxX, boxes[c].maxX);
+                b.maxY = max(b.maxY, boxes[c].maxY);
+            }
+            boxes.push_back(b);
+        }
+        first = last;
+        last = static_cast<int>(boxes.size());
+    } while (last - first > 1);
+    levelStart.push_back(last);
+}
+
+template<typename ItemDistance>
+int SpatialIndex::Tree::nearest(double x, double y, ItemDistance itemDistance) const
+{
+    if (boxes.empty())
+        return -1;
+    int itemCount = static_cast<int>(ids.size());
+
+    //best first: boxes are queued by the distance to their nearest possible
+    //point, items by their exact distance, so the first item popped is nearest
+    typedef pair<double, int> Entry;
+    priority_queue<Entry, vector<Entry>, greater<Entry>> queue;
+    queue.push(Entry(0, static_cast<int>(boxes.size()) - 1));
+    while (!queue.empty())
+    {
+        int b = queue.top().second;
+        queue.pop();
+        if (b < itemCount)
+            return ids[b];
+
+        //b's children are the NODE_SIZE boxes at the same offset one level down
+        int level = static_cast<int>(upper_bound(levelStart.begin(), levelStart.end(), b) - levelStart.begin()) - 1;
+        int first = levelStart[level - 1] + (b - levelStart[level]) * NODE_SIZE;
+        int last = min(first + NODE_SIZE, levelStart[level]);
+        for (int c = first; c < last; c++)
+        {
+            if (c < itemCount)
+                queue.push(Entry(itemDistance(ids[c]), c));
+            else
+            {
+                const Box& box = boxes[c];
+                double dx = max(max(box.minX - x, x - box.maxX), 0.0);
+                double dy = max(max(box.minY - y, y - box.maxY), 0.0);
+                queue.push(Entry(dx * dx + dy * dy, c));
+            }
+        }
+    }
+    return -1;
+}
+
+SpatialIndex::SpatialIndex()
+ : m_graph(nullptr), m_xScale(1), m_buildSeconds(0)
+{
+}
+
+void SpatialIndex::clear()
+{
+    m_graph = nullptr;
+    m_nodes = Tree();
+    m_edges = Tree();
+    m_buildSeconds = 0;
+}
+
+void SpatialIndex::build(const StreetGraph& graph)
+{
+    auto startTime = chrono::steady_clock::now();
+    clear();
+    int n = graph.nodeCount();
+    if (n == 0)
+        return;
+    m_graph = &graph;
+
+    double minLat = numeric_limits<double>::infinity();
+    double maxLat = -minLat;
+    for (int v = 0; v < n; v++)
+    {
+        minLat = min(minLat, graph.latitude(v));
+        maxLat = max(maxLat, graph.latitude(v));
+    }
+    m_xScale = cos((minLat + maxLat) / 2 * 4 * atan(1.0) / 180);
+
+    vector<Box> items(n);
+    vector<int> ids(n);
+    for (int v = 0; v < n; v++)
+    {
+        Box b = { x(v), y(v), x(v), y(v) };
+        items[v] = b;
+        ids[v] = v;
+    }
+    m_nodes.build(items, ids);
+
+    //each segment once, by whichever direction has the smaller edge ID
+    items.clear();
+    ids.clear();
+    for (int e = 0; e < graph.edgeCount(); e++)
+    {
+        int r = graph.reverseEdge(e);
+        if (r >= 0 && r < e)
+            continue;
+        int s = graph.edgeSource(e);
+        int t = graph.edgeTarget(e);
+        Box b = { min(x(s), x(t)), min(y(s), y(t)), max(x(s), x(t)), max(y(s), y(t)) };
+        items.push_back(b);
+        ids.push_back(e);
+    }
+    m_edges.build(items, ids);
+    m_buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+int SpatialIndex::nearestNode(double latitude, double longitude) const
+{
+    if (empty())
+        return -1;
+    double px = longitude * m_xScale;
+    double py = latitude;
+    return m_nodes.nearest(px, py, [&](int v) {
+        double dx = x(v) - px;
+        double dy = y(v) - py;
+        return dx * dx + dy * dy;
+    });
+}
+
+int SpatialIndex::nearestEdge(double latitude, double longitude, double& fraction) const
+{
+    fraction = 0;
+    if (empty())
+        return -1;
+    double px = longitude * m_xScale;
+    double py = latitude;
+    double unused;
+    int e = m_edges.nearest(px, py, [&](int edge) { return edgeDistance(edge, px, py, unused); });
+    if (e >= 0)
+        edgeDistance(e, px, py, fraction);
+    return e;
+}
+
+void SpatialIndex::nearestNodes(const vector<GeoCoord>& points, vector<int>& nodes, unsigned threads) const
+{
+    nodes.assign(points.size(), -1);
+    if (empty() || points.empty())
+        return;
+
+    //answer the points in Hilbert order, so consecutive queries walk mostly
+    //the same boxes, which are then already in cache
+    vector<double> xs(points.size());
+    vector<double> ys(points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        xs[i] = points[i].longitude * m_xScale;
+        ys[i] = points[i].latitude;
+    }
+    vector<int> order = hilbertOrder(xs, ys);
+    int count = static_cast<int>(points.size());
+    WorkStealingPool pool(threads);
+    pool.run((count + BATCH_CHUNK - 1) / BATCH_CHUNK, [&](int chunk, unsigned) {
+        for (int k = chunk * BATCH_CHUNK; k < min(count, (chunk + 1) * BATCH_CHUNK); k++)
+        {
+            int i = order[k];
+            nodes[i] = nearestNode(points[i].latitude, points[i].longitude);
+        }
+    });
+}
+
+double SpatialIndex::edgeDistance(int edge, double px, double py, double& fraction) const
+{
+    int s = m_graph->edgeSource(edge);
+    int t = m_graph->edgeTarget(edge);
+    double ax = x(s);
+    double ay = y(s);
+    double dx = x(t) - ax;
+    double dy = y(t) - ay;
+    double lengthSquared = dx * dx + dy * dy;
+    //project the point onto the segment's line, then clamp to its ends
+    fraction = lengthSquared > 0 ? ((px - ax) * dx + (py - ay) * dy) / lengthSquared : 0;
+    fraction = min(1.0, max(0.0, fraction));
+    double cx = ax + fraction * dx - px;
+    double cy = ay + fraction * dy - py;
+    return cx * cx + cy * cy;
+}
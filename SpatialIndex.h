@@ -0,0 +1,78 @@
+// SpatialIndex.h
+
+// Nearest-node and nearest-segment lookups for arbitrary coordinates, such as
+// customer addresses, which almost never match a map node's text exactly.
+// Nodes and segments each go in a static packed R-tree: the items are sorted
+// along a Hilbert curve so that neighbors on the map are neighbors in the
+// array, then grouped sixteen to a box, level by level up to one root box.
+// A query walks the boxes best-first by their distance to the point, so it
+// touches O(log n) boxes for a map of evenly spread streets.
+//
+// Distances are compared in a flat projection of the map (longitude scaled by
+// the cosine of the map's middle latitude), which over the span of a city
+// orders candidates the same way as distances on the sphere.
+
+#ifndef SPATIALINDEX_INCLUDED
+#define SPATIALINDEX_INCLUDED
+
+#include "provided.h"
+#include "StreetGraph.h"
+#include <vector>
+
+class SpatialIndex
+{
+public:
+    SpatialIndex();
+
+    void clear();
+      // indexes every node and segment of graph, which must outlive the index
+      // or the next build
+    void build(const StreetGraph& graph);
+    bool empty() const { return m_graph == nullptr; }
+    double buildSeconds() const { return m_buildSeconds; }
+
+      // the node nearest the point, or -1 if the index is empty
+    int nearestNode(double latitude, double longitude) const;
+      // the edge nearest the point (one of each segment's two directions), or
+      // -1; fraction is how far along it the closest point lies, from 0 at its
+      // source to 1 at its target
+    int nearestEdge(double latitude, double longitude, double& fraction) const;
+      // nearestNode for every point, on up to threads threads (0 means one per
+      // core); nodes[i] is the answer for points[i]
+    void nearestNodes(const std::vector<GeoCoord>& points, std::vector<int>& nodes, unsigned threads) const;
+
+private:
+    struct Box
+    {
+        double minX;
+        double minY;
+        double maxX;
+        double maxY;
+    };
+
+    // Boxes of every level in one array: the items first, in Hilbert order,
+    // then each level of parents, ending with the root.
+    struct Tree
+    {
+        std::vector<Box> boxes;
+        std::vector<int> ids;        //the item each of the first ids.size() boxes stands for
+        std::vector<int> levelStart; //index in boxes of each level's first box, plus the end
+
+        void build(std::vector<Box>& items, std::vector<int>& itemIds);
+        template<typename ItemDistance>
+        int nearest(double x, double y, ItemDistance itemDistance) const;
+    };
+
+    const StreetGraph* m_graph;
+    double m_xScale; //cosine of the middle latitude
+    Tree m_nodes;
+    Tree m_edges;
+    double m_buildSeconds;
+
+    double x(int node) const { return m_graph->longitude(node) * m_xScale; }
+    double y(int node) const { return m_graph->latitude(node); }
+      // squared flat distance from (px, py) to the edge, and where along it
+    double edgeDistance(int edge, double px, double py, double& fraction) const;
+};
+
+#endif // SPATIALINDEX_INCLUDED
@@ -0,0 +1,545 @@
+#include "provided.h"
+#include "StreetGraph.h"
+#include <string>
+#include <vector>
+#include <functional>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+//******************** snapshot image layout **********************************
+
+// The image is a header followed by the sections below, each aligned to 8
+// bytes.  Built graphs use the same layout in memory, so saving a snapshot is
+// a single write and loading one is a single mmap.
+
+namespace
+{
+    const char SNAPSHOT_MAGIC[8] = { 'G', 'O', 'O', 'B', 'M', 'A', 'P', '\0' };
+    const uint32_t SNAPSHOT_VERSION = 3;
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    enum Section
+    {
+        SEC_LAT, SEC_LON, SEC_EDGE_OFFSET, SEC_EDGE_SOURCE, SEC_EDGE_TARGET,
+        SEC_EDGE_NAME, SEC_EDGE_LENGTH, SEC_TEXT_OFFSET, SEC_TEXT,
+        SEC_NAME_OFFSET, SEC_NAME_TEXT, SEC_NODE_KEY, SEC_INDEX, SEC_UNIT_VECTOR, SECTION_COUNT
+    };
+
+    struct SnapshotHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t nodeCount;
+        uint32_t edgeCount;
+        uint32_t nameCount;
+        uint32_t indexSize;
+        uint64_t textBytes;
+        uint64_t nameBytes;
+        uint64_t sectionOffset[SECTION_COUNT];
+        uint64_t imageSize;
+        uint64_t payloadChecksum;
+        uint64_t headerChecksum; //computed with this field set to 0
+    };
+
+    uint64_t alignUp(uint64_t n)
+    {
+        return (n + 7) & ~uint64_t(7);
+    }
+
+    //fills in the section offsets and image size from the counts in h
+    void computeLayout(SnapshotHeader& h)
+    {
+        uint64_t n = h.nodeCount;
+        uint64_t m = h.edgeCount;
+        uint64_t sizes[SECTION_COUNT] = {
+            8 * n, 8 * n, 4 * (n + 1), 4 * m, 4 * m,
+            4 * m, 8 * m, 4 * (2 * n + 1), h.textBytes,
+            4 * (uint64_t(h.nameCount) + 1), h.nameBytes, 8 * n, 4 * uint64_t(h.indexSize), 24 * n
+        };
+        uint64_t offset = alignUp(sizeof(SnapshotHeader));
+        for (int i = 0; i < SECTION_COUNT; i++)
+        {
+            h.sectionOffset[i] = offset;
+            offset = alignUp(offset + sizes[i]);
+        }
+        h.imageSize = offset;
+    }
+
+    //64-bit multiply-xorshift checksum over whole words
+    uint64_t checksum(const char* bytes, size_t size)
+    {
+        uint64_t h = 0x9E3779B97F4A7C15ULL ^ size;
+        size_t words = size / 8;
+        for (size_t i = 0; i < words; i++)
+        {
+            uint64_t w;
+            memcpy(&w, bytes + 8 * i, 8);
+            h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+            h ^= h >> 32;
+        }
+        for (size_t i = 8 * words; i < size; i++)
+            h = (h ^ static_cast<unsigned char>(bytes[i])) * 0xC4CEB9FE1A85EC53ULL;
+        return h;
+    }
+
+    uint64_t headerChecksum(const SnapshotHeader& h)
+    {
+        SnapshotHeader copy = h;
+        copy.headerChecksum = 0;
+        return checksum(reinterpret_cast<const char*>(&copy), sizeof(copy));
+    }
+
+    double haversineMiles(double lat1, double lon1, double lat2, double lon2)
+    {
+        //same formula as distanceEarthMiles, without building GeoCoords
+        const double earthRadiusKm = 6371.0;
+        const double milesPerKm = 1 / 1.609344;
+        double lat1r = deg2rad(lat1);
+        double lon1r = deg2rad(lon1);
+        double lat2r = deg2rad(lat2);
+        double lon2r = deg2rad(lon2);
+        double u = std::sin((lat2r - lat1r) / 2);
+        double v = std::sin((lon2r - lon1r) / 2);
+        return 2.0 * earthRadiusKm * std::asin(std::sqrt(u * u + std::cos(lat1r) * std::cos(lat2r) * v * v)) * milesPerKm;
+    }
+
+    template<typename T>
+    T* sectionPtr(char* image, const SnapshotHeader& h, Section s)
+    {
+        return reinterpret_cast<T*>(image + h.sectionOffset[s]);
+    }
+
+    template<typename T>
+    const T* sectionPtr(const char* image, const SnapshotHeader& h, Section s)
+    {
+        return reinterpret_cast<const T*>(image + h.sectionOffset[s]);
+    }
+}
+
+NodeKey NodeKey::fromDegrees(double latitude, double longitude)
+{
+    NodeKey key;
+    //written so that NaN fails too
+    if (!(latitude >= -90 && latitude <= 90 && longitude >= -180 && longitude <= 180))
+    {
+        key.bits = INVALID;
+        return key;
+    }
+    uint64_t lat = static_cast<uint64_t>(llround((latitude + 90) * 1e7));
+    uint64_t lon = static_cast<uint64_t>(llround((longitude + 180) * 1e7));
+    key.bits = lat << 32 | lon;
+    return key;
+}
+
+//******************** StreetGraph functions **********************************
+
+StreetGraph::StreetGraph()
+    :m_version(0), m_shortenedVersion(0), m_imageBytes(nullptr), m_imageSize(0), m_mapped(nullptr), m_mappedSize(0)
+{
+    detach();
+}
+
+StreetGraph::~StreetGraph()
+{
+    clear();
+}
+
+void StreetGraph::clear()
+{
+    detach();
+    vector<uint64_t>().swap(m_image);
+    if (m_mapped != nullptr)
+    {
+        munmap(m_mapped, m_mappedSize);
+        m_mapped = nullptr;
+        m_mappedSize = 0;
+    }
+}
+
+void StreetGraph::detach()
+{
+    m_nodeCount = m_edgeCount = m_nameCount = m_indexSize = 0;
+    m_lat = m_lon = m_edgeLength = m_baseLength = m_unitVector = nullptr;
+    vector<double>().swap(m_liveLength);
+    vector<unsigned>().swap(m_edgeVersion);
+    m_shortenedEdges = 0;
+    m_edgeOffset = m_edgeSource = m_edgeTarget = m_edgeName = m_index = nullptr;
+    m_nodeKey = nullptr;
+    m_textOffset = m_nameOffset = nullptr;
+    m_text = m_nameText = nullptr;
+    m_imageBytes = nullptr;
+    m_imageSize = 0;
+}
+
+bool StreetGraph::attach(const void* image, size_t size, bool verifyChecksum)
+{
+    const char* bytes = static_cast<const char*>(image);
+    SnapshotHeader h;
+    if (size < sizeof(h))
+        return false;
+    memcpy(&h, bytes, sizeof(h));
+    if (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 || h.version != SNAPSHOT_VERSION ||
+        h.byteOrder != BYTE_ORDER_MARK || h.headerChecksum != headerChecksum(h))
+        return false;
+
+    //the offsets must be exactly the ones these counts produce
+    SnapshotHeader expected = h;
+    computeLayout(expected);
+    if (memcmp(expected.sectionOffset, h.sectionOffset, sizeof(h.sectionOffset)) != 0 ||
+        expected.imageSize != h.imageSize || h.imageSize > size)
+        return false;
+    //nodeId's probing relies on the table being at most half full, as built
+    if (h.indexSize == 0 || (h.indexSize & (h.indexSize - 1)) != 0 || h.indexSize / 2 < h.nodeCount)
+        return false;
+    if (verifyChecksum && h.payloadChecksum != checksum(bytes + sizeof(h), h.imageSize - sizeof(h)))
+        return false;
+
+    m_nodeCount = h.nodeCount;
+    m_edgeCount = h.edgeCount;
+    m_nameCount = h.nameCount;
+    m_indexSize = h.indexSize;
+    m_lat = sectionPtr<double>(bytes, h, SEC_LAT);
+    m_lon = sectionPtr<double>(bytes, h, SEC_LON);
+    m_edgeOffset = sectionPtr<int>(bytes, h, SEC_EDGE_OFFSET);
+    m_edgeSource = sectionPtr<int>(bytes, h, SEC_EDGE_SOURCE);
+    m_edgeTarget = sectionPtr<int>(bytes, h, SEC_EDGE_TARGET);
+    m_edgeName = sectionPtr<int>(bytes, h, SEC_EDGE_NAME);
+    m_edgeLength = m_baseLength = sectionPtr<double>(bytes, h, SEC_EDGE_LENGTH);
+    m_textOffset = sectionPtr<uint32_t>(bytes, h, SEC_TEXT_OFFSET);
+    m_text = sectionPtr<char>(bytes, h, SEC_TEXT);
+    m_nameOffset = sectionPtr<uint32_t>(bytes, h, SEC_NAME_OFFSET);
+    m_nameText = sectionPtr<char>(bytes, h, SEC_NAME_TEXT);
+    m_nodeKey = sectionPtr<uint64_t>(bytes, h, SEC_NODE_KEY);
+    m_index = sectionPtr<int>(bytes, h, SEC_INDEX);
+    m_unitVector = sectionPtr<double>(bytes, h, SEC_UNIT_VECTOR);
+    m_imageBytes = bytes;
+    m_imageSize = h.imageSize;
+
+    if (!consistent())
+    {
+        detach();
+        return false;
+    }
+    return true;
+}
+
+bool StreetGraph::consistent() const
+{
+    //searches index arrays with these without checking, so a corrupt image
+    //must not get past here
+    if (m_edgeOffset[0] != 0 || m_edgeOffset[m_nodeCount] != m_edgeCount)
+        return false;
+    for (int v = 0; v < m_nodeCount; v++)
+    {
+        if (m_edgeOffset[v] > m_edgeOffset[v + 1])
+            return false;
+        for (int e = m_edgeOffset[v]; e < m_edgeOffset[v + 1]; e++)
+        {
+            if (m_edgeSource[e] != v || m_edgeTarget[e] < 0 || m_edgeTarget[e] >= m_nodeCount ||
+                m_edgeName[e] < 0 || m_edgeName[e] >= m_nameCount)
+                return false;
+        }
+    }
+    for (int slot = 0; slot < m_indexSize; slot++)
+    {
+        if (m_index[slot] >= m_nodeCount)
+            return false;
+    }
+    return true;
+}
+
+bool StreetGraph::loadSnapshot(const string& snapshotFile)
+{
+    clear();
+    int fd = open(snapshotFile.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SnapshotHeader)))
+    {
+        close(fd);
+        return false;
+    }
+    //a shared read-only mapping lets every process on the box use the same page cache copy
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    m_mapped = p;
+    m_mappedSize = st.st_size;
+    if (!attach(p, m_mappedSize, true))
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool StreetGraph::saveSnapshot(const string& snapshotFile) const
+{
+    if (m_imageBytes == nullptr)
+        return false;
+    //write beside the target and rename, so processes mapping the old file are unaffected
+    string tempFile = snapshotFile + ".tmp";
+    {
+        ofstream out(tempFile, ios::binary | ios::trunc);
+        if (!out)
+            return false;
+        out.write(m_imageBytes, m_imageSize);
+        if (!out)
+        {
+            out.close();
+            remove(tempFile.c_str());
+            return false;
+        }
+    }
+    if (rename(tempFile.c_str(), snapshotFile.c_str()) != 0)
+    {
+        remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+int StreetGraph::nodeId(NodeKey key) const
+{
+    if (m_indexSize == 0 || key.bits == NodeKey::INVALID)
+        return -1;
+    unsigned mask = m_indexSize - 1;
+    unsigned slot = NodeKeyHash()(key) & mask;
+    //linear probing; the table is at most half full so an empty slot is always reached
+    while (m_index[slot] >= 0)
+    {
+        int node = m_index[slot];
+        if (m_nodeKey[node] == key.bits)
+            return node;
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+uint64_t StreetGraph::fingerprint() const
+{
+    if (m_imageBytes == nullptr)
+        return 0;
+    SnapshotHeader h;
+    memcpy(&h, m_imageBytes, sizeof(h));
+    return h.payloadChecksum;
+}
+
+GeoCoord StreetGraph::coord(int node) const
+{
+    //fill in the fields directly so the text is not parsed again
+    GeoCoord gc;
+    const char* t = m_text + m_textOffset[2 * node];
+    gc.latitudeText.assign(t, m_textOffset[2 * node + 1] - m_textOffset[2 * node]);
+    t = m_text + m_textOffset[2 * node + 1];
+    gc.longitudeText.assign(t, m_textOffset[2 * node + 2] - m_textOffset[2 * node + 1]);
+    gc.latitude = m_lat[node];
+    gc.longitude = m_lon[node];
+    return gc;
+}
+
+string StreetGraph::edgeName(int edge) const
+{
+    int name = m_edgeName[edge];
+    return string(m_nameText + m_nameOffset[name], m_nameOffset[name + 1] - m_nameOffset[name]);
+}
+
+double StreetGraph::distanceMiles(int from, int to) const
+{
+    return haversineMiles(m_lat[from], m_lon[from], m_lat[to], m_lon[to]);
+}
+
+StreetSegment StreetGraph::segment(int edge) const
+{
+    return StreetSegment(coord(m_edgeSource[edge]), coord(m_edgeTarget[edge]), edgeName(edge));
+}
+
+int StreetGraph::reverseEdge(int edge) const
+{
+    int from = m_edgeSource[edge];
+    int to = m_edgeTarget[edge];
+    for (int e = edgeBegin(to); e != edgeEnd(to); e++)
+    {
+        if (m_edgeTarget[e] == from && m_edgeName[e] == m_edgeName[edge] && m_baseLength[e] == m_baseLength[edge])
+            return e;
+    }
+    return -1;
+}
+
+void StreetGraph::setEdgeLength(int edge, double length)
+{
+    if (m_liveLength.empty())
+    {
+        //the image may be a read-only mapping, so the first change copies the lengths out
+        m_liveLength.assign(m_baseLength, m_baseLength + m_edgeCount);
+        m_edgeVersion.assign(m_edgeCount, 0);
+        m_edgeLength = m_liveLength.data();
+    }
+    double old = m_liveLength[edge];
+    if (length == old)
+        return;
+    m_version++;
+    if (length < old)
+        m_shortenedVersion = m_version;
+    m_shortenedEdges += (length < m_baseLength[edge]) - (old < m_baseLength[edge]);
+    m_liveLength[edge] = length;
+    m_edgeVersion[edge] = m_version;
+}
+
+//******************** StreetGraphBuilder functions ***************************
+
+StreetGraphBuilder::StreetGraphBuilder()
+{
+    m_textOffset.push_back(0);
+}
+
+int StreetGraphBuilder::internNode(const CoordText& text, double latitude, double longitude)
+{
+    int newId = static_cast<int>(m_lat.size());
+    NodeKey key = NodeKey::fromDegrees(latitude, longitude);
+    pair<int*, bool> id = m_nodeIndex.try_emplace(key, newId);
+    if (!id.second)
+        return *id.first;
+    m_lat.push_back(latitude);
+    m_lon.push_back(longitude);
+    m_key.push_back(key.bits);
+    m_text.insert(m_text.end(), text.lat, text.lat + text.latLen);
+    m_textOffset.push_back(static_cast<uint32_t>(m_text.size()));
+    m_text.insert(m_text.end(), text.lon, text.lon + text.lonLen);
+    m_textOffset.push_back(static_cast<uint32_t>(m_text.size()));
+    return newId;
+}
+
+int StreetGraphBuilder::internName(const string& name)
+{
+    int newId = static_cast<int>(m_names.size());
+    pair<int*, bool> id = m_nameIndex.try_emplace(name, newId);
+    if (id.second)
+        m_names.push_back(name);
+    return *id.first;
+}
+
+void StreetGraphBuilder::reserve(int segments, int nodes)
+{
+    m_segs.reserve(segments);
+    m_lat.reserve(nodes);
+    m_lon.reserve(nodes);
+    m_key.reserve(nodes);
+    m_textOffset.reserve(2 * nodes + 1);
+    m_nodeIndex.reserve(nodes);
+}
+
+void StreetGraphBuilder::addSegment(int from, int to, int name)
+{
+    RawSegment seg = { from, to, name };
+    m_segs.push_back(seg);
+}
+
+void StreetGraphBuilder::build(StreetGraph& graph)
+{
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.byteOrder = BYTE_ORDER_MARK;
+    h.nodeCount = static_cast<uint32_t>(m_lat.size());
+    h.edgeCount = static_cast<uint32_t>(m_segs.size());
+    h.nameCount = static_cast<uint32_t>(m_names.size());
+    h.indexSize = 16;
+    while (h.indexSize < 2 * h.nodeCount)
+        h.indexSize *= 2;
+    h.textBytes = m_text.size();
+    for (size_t i = 0; i < m_names.size(); i++)
+        h.nameBytes += m_names[i].size();
+    computeLayout(h);
+
+    vector<uint64_t> image(h.imageSize / 8, 0);
+    char* bytes = reinterpret_cast<char*>(image.data());
+    int n = h.nodeCount;
+    int m = h.edgeCount;
+
+    //nodes: coordinates, their keys, their unit vectors and their text
+    double* lat = sectionPtr<double>(bytes, h, SEC_LAT);
+    double* lon = sectionPtr<double>(bytes, h, SEC_LON);
+    uint64_t* nodeKey = sectionPtr<uint64_t>(bytes, h, SEC_NODE_KEY);
+    uint32_t* textOffset = sectionPtr<uint32_t>(bytes, h, SEC_TEXT_OFFSET);
+    char* text = sectionPtr<char>(bytes, h, SEC_TEXT);
+    if (n > 0)
+    {
+        memcpy(lat, m_lat.data(), 8 * n);
+        memcpy(lon, m_lon.data(), 8 * n);
+        memcpy(nodeKey, m_key.data(), 8 * n);
+        memcpy(text, m_text.data(), m_text.size());
+    }
+    memcpy(textOffset, m_textOffset.data(), 4 * (2 * n + 1));
+    double* unit = sectionPtr<double>(bytes, h, SEC_UNIT_VECTOR);
+    for (int u = 0; u < n; u++)
+        unitVector(lat[u], lon[u], unit + 3 * u);
+
+    //street names
+    uint32_t* nameOffset = sectionPtr<uint32_t>(bytes, h, SEC_NAME_OFFSET);
+    char* nameText = sectionPtr<char>(bytes, h, SEC_NAME_TEXT);
+    uint32_t pos = 0;
+    for (size_t i = 0; i < m_names.size(); i++)
+    {
+        nameOffset[i] = pos;
+        memcpy(nameText + pos, m_names[i].data(), m_names[i].size());
+        pos += m_names[i].size();
+    }
+    nameOffset[m_names.size()] = pos;
+
+    //count the out degree of every node, then turn the counts into offsets
+    int* edgeOffset = sectionPtr<int>(bytes, h, SEC_EDGE_OFFSET);
+    for (int i = 0; i < m; i++)
+        edgeOffset[m_segs[i].from + 1]++;
+    for (int u = 0; u < n; u++)
+        edgeOffset[u + 1] += edgeOffset[u];
+
+    //place every segment in its node's run, keeping input order
+    int* edgeSource = sectionPtr<int>(bytes, h, SEC_EDGE_SOURCE);
+    int* edgeTarget = sectionPtr<int>(bytes, h, SEC_EDGE_TARGET);
+    int* edgeName = sectionPtr<int>(bytes, h, SEC_EDGE_NAME);
+    double* edgeLength = sectionPtr<double>(bytes, h, SEC_EDGE_LENGTH);
+    vector<int> next(edgeOffset, edgeOffset + n);
+    for (int i = 0; i < m; i++)
+    {
+        const RawSegment& seg = m_segs[i];
+        int e = next[seg.from]++;
+        edgeSource[e] = seg.from;
+        edgeTarget[e] = seg.to;
+        edgeName[e] = seg.name;
+        edgeLength[e] = haversineMiles(lat[seg.from], lon[seg.from], lat[seg.to], lon[seg.to]);
+    }
+
+    //coordinate lookup table
+    int* index = sectionPtr<int>(bytes, h, SEC_INDEX);
+    unsigned mask = h.indexSize - 1;
+    for (unsigned i = 0; i < h.indexSize; i++)
+        index[i] = -1;
+    for (int u = 0; u < n; u++)
+    {
+        NodeKey key = { m_key[u] };
+        unsigned slot = NodeKeyHash()(key) & mask;
+        while (index[slot] >= 0)
+            slot = (slot + 1) & mask;
+        index[slot] = u;
+    }
+
+    h.payloadChecksum = checksum(bytes + sizeof(h), h.imageSize - sizeof(h));
+    h.headerChecksum = headerChecksum(h);
+    memcpy(bytes, &h, sizeof(h));
+
+    graph.clear();
+    graph.m_image.swap(image);
+    graph.attach(graph.m_image.data(), h.imageSize, false);
+}
@@ -0,0 +1,276 @@
+// StreetGraph.h
+
+// Compact, read-only adjacency structure for the street network.
+// StreetMap::load interns every distinct GeoCoord as an integer node ID and
+// stores the segments leaving each node in one contiguous run of edge slots
+// (compressed sparse row): the segments that start at node u are the edges
+// [edgeBegin(u), edgeEnd(u)).  Coordinates, edge lengths and street names are
+// stored once, so searches can walk the graph with array indexing only.
+//
+// All of the arrays live in one flat image whose layout is also the on-disk
+// snapshot format, so a compiled snapshot can be mmap'ed and used in place.
+// Nodes are looked up by their NodeKey, so finding a GeoCoord's node hashes
+// and compares two integers rather than its text.  Each node's unit vector is
+// stored too, so search heuristics can bound the distance left with a square
+// root instead of the haversine formula.
+//
+// Edge lengths alone can change after loading, for road closures and the
+// like.  The first change copies the lengths out of the image; the image
+// keeps the map's own (base) lengths, which are what snapshots save and what
+// contraction hierarchies and landmarks are built on.  Every change bumps a
+// version number and stamps the edge with it, so a structure derived from the
+// lengths can tell cheaply whether what it holds still applies:
+//   - while no edge is shorter than its base length, any base shortest path
+//     none of whose edges changed is still a shortest path, and base lower
+//     bounds are still lower bounds;
+//   - a route found at version V stays shortest until one of its edges
+//     changes or some edge gets shorter after V.
+
+#ifndef STREETGRAPH_INCLUDED
+#define STREETGRAPH_INCLUDED
+
+#include "provided.h"
+#include "CrowPoints.h"
+#include "FlatHashMap.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A coordinate pair as fixed-point integers in units of 1e-7 degree (about
+// a centimeter), packed into one word: latitude + 90 degrees in the high
+// half, longitude + 180 degrees in the low half.  Map files give coordinates
+// to seven decimals, so keys are exact for them; coordinates that round to
+// the same units are the same node.  Coordinates off the globe all get the
+// one key INVALID.
+struct NodeKey
+{
+    static const std::uint64_t INVALID = ~std::uint64_t(0);
+    std::uint64_t bits;
+
+    static NodeKey fromDegrees(double latitude, double longitude);
+};
+
+inline bool operator==(NodeKey lhs, NodeKey rhs) { return lhs.bits == rhs.bits; }
+
+struct NodeKeyHash
+{
+    //the splitmix64 finalizer; stable across processes, so snapshots can store tables built with it
+    unsigned int operator()(NodeKey k) const
+    {
+        std::uint64_t h = k.bits;
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+        return static_cast<unsigned int>(h ^ (h >> 31));
+    }
+};
+
+class StreetGraph
+{
+public:
+    // Range of the edge IDs leaving one node.  Iterating it touches only the
+    // edge arrays, so nothing is copied or allocated.
+    class EdgeRange
+    {
+    public:
+        class iterator
+        {
+        public:
+            explicit iterator(int edge) : m_edge(edge) {}
+            int operator*() const { return m_edge; }
+            iterator& operator++() { m_edge++; return *this; }
+            bool operator!=(const iterator& other) const { return m_edge != other.m_edge; }
+        private:
+            int m_edge;
+        };
+
+        EdgeRange(int first, int last) : m_first(first), m_last(last) {}
+        iterator begin() const { return iterator(m_first); }
+        iterator end() const { return iterator(m_last); }
+        int size() const { return m_last - m_first; }
+        bool empty() const { return m_first == m_last; }
+    private:
+        int m_first;
+        int m_last;
+    };
+
+    StreetGraph();
+    ~StreetGraph();
+    void clear();
+
+      // maps a compiled snapshot read-only; returns false (leaving the graph
+      // empty) if the file is missing, truncated, corrupt or of another version
+    bool loadSnapshot(const std::string& snapshotFile);
+    bool saveSnapshot(const std::string& snapshotFile) const;
+
+      // returns -1 if gc is not a node of the map
+    int nodeId(const GeoCoord& gc) const { return nodeId(NodeKey::fromDegrees(gc.latitude, gc.longitude)); }
+    int nodeId(NodeKey key) const;
+
+      // checksum of the image contents; identifies this exact map so files
+      // derived from it (such as a contraction hierarchy) can be matched to it
+    std::uint64_t fingerprint() const;
+
+    int nodeCount() const { return m_nodeCount; }
+    int edgeCount() const { return m_edgeCount; }
+
+    double latitude(int node) const { return m_lat[node]; }
+    double longitude(int node) const { return m_lon[node]; }
+    GeoCoord coord(int node) const;
+
+    int edgeBegin(int node) const { return m_edgeOffset[node]; }
+    int edgeEnd(int node) const { return m_edgeOffset[node + 1]; }
+    EdgeRange edges(int node) const { return EdgeRange(edgeBegin(node), edgeEnd(node)); }
+    int edgeSource(int edge) const { return m_edgeSource[edge]; }
+    int edgeTarget(int edge) const { return m_edgeTarget[edge]; }
+      // the current length; infinite for a closed edge
+    double edgeLength(int edge) const { return m_edgeLength[edge]; }
+    int edgeNameId(int edge) const { return m_edgeName[edge]; }
+    std::string edgeName(int edge) const;
+    StreetSegment segment(int edge) const;
+      // the edge for the same segment driven the other way, which load()
+      // always stores; -1 if there is none
+    int reverseEdge(int edge) const;
+
+      // crow-fly distance between two nodes, in miles
+    double distanceMiles(int from, int to) const;
+      // the node's unit vector (see CrowPoints), as x, y and z
+    const double* unitVector(int node) const { return m_unitVector + 3 * node; }
+      // the straight line between two nodes through the Earth, in miles: a
+      // lower bound on distanceMiles (for nodes ten miles apart, short of it
+      // by under a millionth) that takes no trigonometry.  Like any
+      // straight-line distance it satisfies the triangle inequality, so it is
+      // a consistent search heuristic; it is scaled down by a part in 10^9 so
+      // that rounding can't undo that.
+    double chordMiles(int from, int to) const
+    {
+        const double* a = unitVector(from);
+        const double* b = unitVector(to);
+        double dx = a[0] - b[0];
+        double dy = a[1] - b[1];
+        double dz = a[2] - b[2];
+        return std::sqrt(dx * dx + dy * dy + dz * dz) * (EARTH_RADIUS_MILES * (1 - 1e-9));
+    }
+
+      // changes one edge's length in place (infinity closes it); like loading,
+      // this must not overlap any other use of the graph.  Bidirectional
+      // search assumes both directions of a segment are the same length, so
+      // StreetMap changes them together.
+    void setEdgeLength(int edge, double length);
+    double baseEdgeLength(int edge) const { return m_baseLength[edge]; }
+    bool edgeModified(int edge) const { return m_edgeLength != m_baseLength && m_edgeLength[edge] != m_baseLength[edge]; }
+      // bumped by every change; never reset, even by loading another map
+    unsigned version() const { return m_version; }
+      // the version of the edge's last change, 0 if it has the base length
+      // and never had another
+    unsigned edgeVersion(int edge) const { return m_edgeVersion.empty() ? 0 : m_edgeVersion[edge]; }
+      // the last version at which some edge got shorter, 0 if none has
+    unsigned shortenedVersion() const { return m_shortenedVersion; }
+      // how many edges are now shorter than their base length
+    int shortenedEdges() const { return m_shortenedEdges; }
+
+      // C++11 syntax for preventing copying and assignment
+    StreetGraph(const StreetGraph&) = delete;
+    StreetGraph& operator=(const StreetGraph&) = delete;
+
+private:
+    friend class StreetGraphBuilder;
+
+    //views into the current image
+    int m_nodeCount;
+    int m_edgeCount;
+    int m_nameCount;
+    int m_indexSize;
+    const double* m_lat;
+    const double* m_lon;
+    const int* m_edgeOffset; //nodeCount()+1 entries
+    const int* m_edgeSource;
+    const int* m_edgeTarget;
+    const int* m_edgeName;
+    const double* m_edgeLength;
+    const std::uint32_t* m_textOffset; //latitude and longitude text of each node
+    const char* m_text;
+    const std::uint32_t* m_nameOffset;
+    const char* m_nameText;
+    const std::uint64_t* m_nodeKey;
+    const int* m_index; //open addressing table of node IDs by NodeKeyHash, -1 if empty
+    const double* m_baseLength; //the image's lengths; m_edgeLength points here until one changes
+    const double* m_unitVector; //three per node
+
+    //live lengths, allocated on the first change
+    std::vector<double> m_liveLength;
+    std::vector<unsigned> m_edgeVersion;
+    unsigned m_version;
+    unsigned m_shortenedVersion;
+    int m_shortenedEdges;
+
+    //storage behind the views: either an image built in memory or a mapped file
+    const char* m_imageBytes;
+    std::size_t m_imageSize;
+    std::vector<std::uint64_t> m_image;
+    void* m_mapped;
+    std::size_t m_mappedSize;
+
+    bool attach(const void* image, std::size_t size, bool verifyChecksum);
+    bool consistent() const; //edge and index entries in range, as attach requires
+    void detach();
+};
+
+// Text of one coordinate pair inside a buffer (such as a mapped map file)
+// that outlives the StreetGraphBuilder it is interned into.
+struct CoordText
+{
+    const char* lat;
+    const char* lon;
+    int latLen;
+    int lonLen;
+};
+
+// Accumulates nodes, street names and segments while a map file is read, then
+// lays them out as a StreetGraph image in one counting pass.
+class StreetGraphBuilder
+{
+public:
+    StreetGraphBuilder();
+
+      // returns the ID of the node at these coordinates, adding it with this
+      // text if it is new
+    int internNode(const CoordText& text, double latitude, double longitude);
+      // returns the ID of the street name, adding it if it is new
+    int internName(const std::string& name);
+      // make room for a known number of segments and an estimated number of nodes
+    void reserve(int segments, int nodes);
+    void addSegment(int from, int to, int name);
+
+      // replaces the contents of graph; segments keep their input order
+      // within each node
+    void build(StreetGraph& graph);
+
+      // C++11 syntax for preventing copying and assignment
+    StreetGraphBuilder(const StreetGraphBuilder&) = delete;
+    StreetGraphBuilder& operator=(const StreetGraphBuilder&) = delete;
+
+private:
+    struct RawSegment
+    {
+        int from;
+        int to;
+        int name;
+    };
+
+    //per node
+    std::vector<double> m_lat;
+    std::vector<double> m_lon;
+    std::vector<std::uint64_t> m_key;
+    std::vector<std::uint32_t> m_textOffset;
+    std::vector<char> m_text;
+
+    std::vector<std::string> m_names;
+    std::vector<RawSegment> m_segs;
+    FlatHashMap<NodeKey, int, NodeKeyHash> m_nodeIndex;
+    FlatHashMap<std::string, int, std::hash<std::string>> m_nameIndex;
+};
+
+#endif // STREETGRAPH_INCLUDED
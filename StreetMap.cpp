@@ -2,14 +2,37 @@
 #include <string>
 #include <vector>
 #include <functional>
-#include <fstream>
-#include "ExpandableHashMap.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "StreetGraph.h"
+#include "FlatHashMap.h"
+#include "ContractionHierarchy.h"
+#include "LandmarkIndex.h"
+#include "RouteCache.h"
+#include "SpatialIndex.h"
+#include "EdgeCosts.h"
 using namespace std;
 
-
-unsigned int hasher(const GeoCoord& g)
+namespace
 {
-    return std::hash<string>()(g.latitudeText + g.longitudeText);
+    struct EdgeHash
+    {
+        unsigned int operator()(int edge) const
+        {
+            unsigned int h = static_cast<unsigned int>(edge) * 0x9E3779B1U;
+            return h ^ (h >> 16);
+        }
+    };
 }
 
 class StreetMapImpl
@@ -18,13 +41,42 @@ public:
     StreetMapImpl();
     ~StreetMapImpl();
     bool load(string mapFile);
+    bool loadSnapshot(string snapshotFile);
+    bool saveSnapshot(string snapshotFile) const;
     bool getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const;
+    bool nearestNode(const GeoCoord& gc, GeoCoord& node, double& miles) const;
+    bool nearestSegment(const GeoCoord& gc, StreetSegment& segment, GeoCoord& closest, double& miles) const;
+    void snapToNodes(const vector<GeoCoord>& points, vector<GeoCoord>& nodes, vector<double>& miles, unsigned threads) const;
+    const StreetGraph* graph() const;
+    const MapLoadStats& loadStats() const;
+    bool prepareContractionHierarchy(string chFile);
+    const ContractionHierarchy* hierarchy() const;
+    const HierarchyStats& hierarchyStats() const;
+    bool prepareLandmarks(int count, const vector<GeoCoord>& seeds);
+    const LandmarkIndex* landmarks() const;
+    void setRouteCacheBudget(double megabytes);
+    RouteCacheStats routeCacheStats() const;
+    RouteCache* routeCache();
+    const EdgeCosts* edgeCosts() const;
+    bool setSegmentOpen(const GeoCoord& start, const GeoCoord& end, bool open);
+    bool setSegmentLength(const GeoCoord& start, const GeoCoord& end, double miles);
+    unsigned mapVersion() const;
 private:
-    ExpandableHashMap<GeoCoord, vector<StreetSegment>> m_streetMap;
-    void addToMap(GeoCoord& g, StreetSegment& seg);
+    StreetGraph m_graph;
+    MapLoadStats m_loadStats;
+    ContractionHierarchy m_hierarchy;
+    LandmarkIndex m_landmarks;
+    RouteCache m_routeCache;
+    SpatialIndex m_spatialIndex;
+    EdgeCosts m_edgeCosts;
+    //closed edges, with the length each gets back when reopened
+    FlatHashMap<int, double, EdgeHash> m_closed;
+
+    bool segmentEdges(const GeoCoord& start, const GeoCoord& end, vector<int>& edges) const;
 };
 
 StreetMapImpl::StreetMapImpl()
+    :m_routeCache(m_graph, 32)
 {
 }
 
@@ -32,64 +84,313 @@ StreetMapImpl::~StreetMapImpl()
 {
 }
 
-void StreetMapImpl::addToMap(GeoCoord &g, StreetSegment &seg)
+namespace
 {
-    vector<StreetSegment> temp;
-    
-    if (m_streetMap.find(g) == nullptr) //if the segment is not found, make new association
+    //one street in the map file: its name line and the lines holding its segments
+    struct StreetRecord
     {
-        temp.push_back(seg);
-        m_streetMap.associate(g, temp);
+        const char* name;
+        int nameLen;
+        const char* coords;
+        const char* coordsEnd;
+        int firstSegment;
+        int segmentCount;
+    };
+
+    struct ParsedCoord
+    {
+        CoordText text;
+        double latitude;
+        double longitude;
+    };
+
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
     }
-    else
-        //if there already exists another mapping with same key, we must add the value without deleting the pre existing mapping
+
+    const char* endOfLine(const char* p, const char* end)
     {
-        //add the segment to the vector
-        temp = *(m_streetMap.find(g));
-        temp.push_back(seg);
-        //re associate the new vector containing all previous segments plus our new segment
-        m_streetMap.associate(g, temp);
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        return nl == nullptr ? end : nl;
+    }
+
+    const char* nextLine(const char* p, const char* end)
+    {
+        const char* lineEnd = endOfLine(p, end);
+        return lineEnd == end ? end : lineEnd + 1;
+    }
+
+    //parses one decimal token the way std::stod would.  Plain decimals with at
+    //most 15 significant digits take Clinger's fast path: mantissa and power
+    //of ten are both exact doubles, so one correctly rounded division gives
+    //the same result as strtod.  Anything else falls back to strtod.
+    bool parseDouble(const char* p, int len, double& value)
+    {
+        static const double powersOf10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        const char* s = p;
+        const char* end = p + len;
+        bool negative = false;
+        if (s != end && (*s == '-' || *s == '+'))
+            negative = (*s++ == '-');
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int fractionDigits = 0;
+        bool seenDigit = false;
+        bool seenPoint = false;
+        for (; s != end; s++)
+        {
+            if (*s >= '0' && *s <= '9')
+            {
+                seenDigit = true;
+                if (mantissa != 0 || *s != '0')
+                    digits++;
+                mantissa = mantissa * 10 + (*s - '0');
+                if (seenPoint)
+                    fractionDigits++;
+                if (digits > 15)
+                    break;
+            }
+            else if (*s == '.' && !seenPoint)
+                seenPoint = true;
+            else
+                break;
+        }
+        if (s == end && seenDigit && fractionDigits <= 22)
+        {
+            double v = static_cast<double>(mantissa) / powersOf10[fractionDigits];
+            value = negative ? -v : v;
+            return true;
+        }
+
+        char buffer[64];
+        if (len >= static_cast<int>(sizeof(buffer)))
+            return false;
+        memcpy(buffer, p, len);
+        buffer[len] = '\0';
+        char* parsedEnd;
+        value = strtod(buffer, &parsedEnd);
+        return parsedEnd != buffer;
+    }
+
+    //parses every coordinate token of the given streets into out, two per segment
+    bool parseRecords(const StreetRecord* first, const StreetRecord* last, ParsedCoord* out)
+    {
+        for (const StreetRecord* r = first; r != last; r++)
+        {
+            const char* p = r->coords;
+            ParsedCoord* dest = out + 2 * r->firstSegment;
+            int tokens = 4 * r->segmentCount;
+            for (int i = 0; i < tokens; i++)
+            {
+                while (p != r->coordsEnd && isSpace(*p))
+                    p++;
+                const char* tokenStart = p;
+                while (p != r->coordsEnd && !isSpace(*p))
+                    p++;
+                int len = static_cast<int>(p - tokenStart);
+                double v;
+                if (len == 0 || !parseDouble(tokenStart, len, v))
+                    return false;
+                //tokens alternate latitude, longitude for the start then the end
+                ParsedCoord& pc = dest[i / 2];
+                if (i % 2 == 0)
+                {
+                    pc.text.lat = tokenStart;
+                    pc.text.latLen = len;
+                    pc.latitude = v;
+                }
+                else
+                {
+                    pc.text.lon = tokenStart;
+                    pc.text.lonLen = len;
+                    pc.longitude = v;
+                }
+            }
+        }
+        return true;
     }
-    
-   
 }
 
 bool StreetMapImpl::load(string mapFile)
 {
-    ifstream mapdata(mapFile);
-    if (!mapdata)
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+    int fd = open(mapFile.c_str(), O_RDONLY);
+    if (fd < 0)
         //if data fails to load, return false
         return false;
-    string name,temp;
-    while (getline(mapdata,name))
-        //getline increments file line with every call
-    {
-        int C;
-        mapdata >> C;
-        string s_lat, s_long, e_lat, e_long;
-        
-        for (int i = 0; i < C; i++)
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* mapped = nullptr;
+    if (size > 0)
+    {
+        mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    const char* data = static_cast<const char*>(mapped);
+    const char* end = data + size;
+
+    //split the file at street boundaries: a name line, a count line, then
+    //one line per segment.  Only newlines are scanned here.
+    vector<StreetRecord> records;
+    int segmentCount = 0;
+    bool ok = true;
+    const char* p = data;
+    while (p != end)
+    {
+        const char* lineEnd = endOfLine(p, end);
+        const char* q = p;
+        while (q != lineEnd && isSpace(*q))
+            q++;
+        if (q == lineEnd)
+            //skip blank lines between streets
+        {
+            p = nextLine(p, end);
+            continue;
+        }
+        StreetRecord r;
+        r.name = p;
+        r.nameLen = static_cast<int>(lineEnd - p);
+        p = nextLine(p, end);
+
+        string countText(p, endOfLine(p, end));
+        char* countEnd;
+        long C = strtol(countText.c_str(), &countEnd, 10);
+        if (countEnd == countText.c_str() || C < 0)
+        {
+            ok = false;
+            break;
+        }
+        p = nextLine(p, end);
+        r.coords = p;
+        for (long i = 0; i < C; i++)
+            p = nextLine(p, end);
+        r.coordsEnd = p;
+        r.firstSegment = segmentCount;
+        r.segmentCount = static_cast<int>(C);
+        segmentCount += r.segmentCount;
+        records.push_back(r);
+    }
+
+    //parse the coordinates on every core, splitting the streets into runs of similar byte size
+    vector<ParsedCoord> coords(2 * static_cast<size_t>(segmentCount));
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    if (ok && !records.empty())
+    {
+        vector<size_t> bounds(1, 0);
+        size_t bytesPerThread = size / threads + 1;
+        const char* chunkStart = records[0].name;
+        for (size_t i = 0; i + 1 < records.size(); i++)
+        {
+            if (static_cast<size_t>(records[i].coordsEnd - chunkStart) >= bytesPerThread && bounds.size() < threads)
+            {
+                bounds.push_back(i + 1);
+                chunkStart = records[i].coordsEnd;
+            }
+        }
+        bounds.push_back(records.size());
+        threads = static_cast<unsigned>(bounds.size() - 1);
+
+        vector<char> results(threads, 1);
+        vector<thread> workers;
+        for (unsigned t = 1; t < threads; t++)
+            workers.push_back(thread([&, t]() {
+                results[t] = parseRecords(&records[0] + bounds[t], &records[0] + bounds[t + 1], coords.data());
+            }));
+        results[0] = parseRecords(&records[0], &records[0] + bounds[1], coords.data());
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+        for (unsigned t = 0; t < threads; t++)
+            ok = ok && results[t];
+    }
+
+    if (ok)
+    {
+        //intern the nodes and names, then lay out every node's segments contiguously in one pass
+        StreetGraphBuilder builder;
+        //road networks have roughly one node per segment
+        builder.reserve(2 * segmentCount, segmentCount);
+        for (size_t i = 0; i < records.size(); i++)
         {
-            mapdata >> s_lat >> s_long >> e_lat >> e_long;
-            //create segment
-            GeoCoord start(s_lat,s_long);
-            GeoCoord end(e_lat,e_long);
-            StreetSegment forward(start,end,name);
-            StreetSegment backward(end,start,name);
-            
-            //add to the map a segment mapping its starting geocoord to the forward segment
-            addToMap(start, forward);
-            //add to the map a segment mapping its ending geocoord to its reverse segment
-            addToMap(end, backward);
+            int nameId = builder.internName(string(records[i].name, records[i].nameLen));
+            for (int j = records[i].firstSegment; j != records[i].firstSegment + records[i].segmentCount; j++)
+            {
+                const ParsedCoord& s = coords[2 * j];
+                const ParsedCoord& e = coords[2 * j + 1];
+                int start = builder.internNode(s.text, s.latitude, s.longitude);
+                int end = builder.internNode(e.text, e.latitude, e.longitude);
+                
+                //the forward segment starts at its starting geocoord, the reverse segment at its ending geocoord
+                builder.addSegment(start, end, nameId);
+                builder.addSegment(end, start, nameId);
+            }
         }
-        getline(mapdata,temp); //skip a line
+        //everything derived from the old map stays in use until here, so a
+        //failed load leaves it as it was
+        m_hierarchy.clear();
+        m_landmarks.clear();
+        m_routeCache.clear();
+        m_spatialIndex.clear();
+        m_edgeCosts.clear();
+        m_closed.reset();
+        builder.build(m_graph);
     }
+    if (mapped != nullptr)
+        munmap(mapped, size);
+    if (!ok)
+        return false;
+    m_spatialIndex.build(m_graph);
+    m_edgeCosts.build(m_graph);
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    m_loadStats.megabytes = size / 1e6;
+    m_loadStats.seconds = seconds;
+    m_loadStats.megabytesPerSecond = seconds > 0 ? m_loadStats.megabytes / seconds : 0;
+    m_loadStats.threads = threads;
+    m_loadStats.nodes = m_graph.nodeCount();
+    m_loadStats.segments = segmentCount;
+    m_loadStats.indexSeconds = m_spatialIndex.buildSeconds();
     return true;
-   }
+}
+
+bool StreetMapImpl::loadSnapshot(string snapshotFile)
+{
+    m_hierarchy.clear();
+    m_landmarks.clear();
+    m_routeCache.clear();
+    m_spatialIndex.clear();
+    m_edgeCosts.clear();
+    m_closed.reset();
+    if (!m_graph.loadSnapshot(snapshotFile))
+        return false;
+    m_spatialIndex.build(m_graph);
+    m_edgeCosts.build(m_graph);
+    return true;
+}
+
+bool StreetMapImpl::saveSnapshot(string snapshotFile) const
+{
+    return m_graph.saveSnapshot(snapshotFile);
+}
 
 bool StreetMapImpl::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
 {
-    if (m_streetMap.find(gc) == nullptr)
+    int node = m_graph.nodeId(gc);
+    if (node < 0)
     {
         //if they key was not found
         return false;
@@ -100,10 +401,209 @@ bool StreetMapImpl::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSe
         segs.clear();
     }
 
-    segs = *m_streetMap.find(gc);
+    for (int e = m_graph.edgeBegin(node); e != m_graph.edgeEnd(node); e++)
+        segs.push_back(m_graph.segment(e));
+    return true;
+}
+
+namespace
+{
+    //a coordinate with the same number of decimals the map files use
+    GeoCoord makeCoord(double latitude, double longitude)
+    {
+        char lat[32];
+        char lon[32];
+        snprintf(lat, sizeof(lat), "%.7f", latitude);
+        snprintf(lon, sizeof(lon), "%.7f", longitude);
+        return GeoCoord(lat, lon);
+    }
+}
+
+bool StreetMapImpl::nearestNode(const GeoCoord& gc, GeoCoord& node, double& miles) const
+{
+    int v = m_spatialIndex.nearestNode(gc.latitude, gc.longitude);
+    if (v < 0)
+        return false;
+    node = m_graph.coord(v);
+    miles = distanceEarthMiles(gc, node);
+    return true;
+}
+
+bool StreetMapImpl::nearestSegment(const GeoCoord& gc, StreetSegment& segment, GeoCoord& closest, double& miles) const
+{
+    double fraction;
+    int e = m_spatialIndex.nearestEdge(gc.latitude, gc.longitude, fraction);
+    if (e < 0)
+        return false;
+    segment = m_graph.segment(e);
+    //the ends themselves keep their map text, so they still match nodes exactly
+    if (fraction == 0)
+        closest = segment.start;
+    else if (fraction == 1)
+        closest = segment.end;
+    else
+        closest = makeCoord(segment.start.latitude + fraction * (segment.end.latitude - segment.start.latitude),
+                            segment.start.longitude + fraction * (segment.end.longitude - segment.start.longitude));
+    miles = distanceEarthMiles(gc, closest);
+    return true;
+}
+
+void StreetMapImpl::snapToNodes(const vector<GeoCoord>& points, vector<GeoCoord>& nodes, vector<double>& miles, unsigned threads) const
+{
+    nodes.clear();
+    miles.clear();
+    if (m_spatialIndex.empty())
+        return;
+    vector<int> ids;
+    m_spatialIndex.nearestNodes(points, ids, threads);
+    nodes.reserve(points.size());
+    miles.reserve(points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        nodes.push_back(m_graph.coord(ids[i]));
+        miles.push_back(distanceEarthMiles(points[i], nodes.back()));
+    }
+}
+
+const StreetGraph* StreetMapImpl::graph() const
+{
+    return &m_graph;
+}
+
+const MapLoadStats& StreetMapImpl::loadStats() const
+{
+    return m_loadStats;
+}
+
+bool StreetMapImpl::prepareContractionHierarchy(string chFile)
+{
+    if (m_graph.nodeCount() == 0)
+        return false;
+    if (m_hierarchy.load(chFile, m_graph))
+        return true;
+    //missing, or built for a different map: contract this one and keep it;
+    //the hierarchy is usable even if it can't be written, and its stats say so
+    m_hierarchy.build(m_graph);
+    m_hierarchy.save(chFile);
+    return true;
+}
+
+const ContractionHierarchy* StreetMapImpl::hierarchy() const
+{
+    return m_hierarchy.empty() ? nullptr : &m_hierarchy;
+}
+
+const HierarchyStats& StreetMapImpl::hierarchyStats() const
+{
+    return m_hierarchy.stats();
+}
+
+bool StreetMapImpl::prepareLandmarks(int count, const vector<GeoCoord>& seeds)
+{
+    vector<int> seedNodes;
+    for (size_t i = 0; i < seeds.size(); i++)
+    {
+        int node = m_graph.nodeId(seeds[i]);
+        if (node >= 0)
+            seedNodes.push_back(node);
+    }
+    m_landmarks.build(m_graph, count, seedNodes);
+    return !m_landmarks.empty();
+}
+
+const LandmarkIndex* StreetMapImpl::landmarks() const
+{
+    return m_landmarks.empty() ? nullptr : &m_landmarks;
+}
+
+void StreetMapImpl::setRouteCacheBudget(double megabytes)
+{
+    m_routeCache.setBudget(megabytes);
+}
+
+RouteCacheStats StreetMapImpl::routeCacheStats() const
+{
+    return m_routeCache.stats();
+}
+
+RouteCache* StreetMapImpl::routeCache()
+{
+    return &m_routeCache;
+}
+
+bool StreetMapImpl::segmentEdges(const GeoCoord& start, const GeoCoord& end, vector<int>& edges) const
+{
+    edges.clear();
+    int u = m_graph.nodeId(start);
+    int v = m_graph.nodeId(end);
+    if (u < 0 || v < 0)
+        return false;
+    //every street joining the two, both ways
+    for (int e : m_graph.edges(u))
+    {
+        if (m_graph.edgeTarget(e) == v)
+            edges.push_back(e);
+    }
+    for (int e : m_graph.edges(v))
+    {
+        if (m_graph.edgeTarget(e) == u)
+            edges.push_back(e);
+    }
+    return !edges.empty();
+}
+
+bool StreetMapImpl::setSegmentOpen(const GeoCoord& start, const GeoCoord& end, bool open)
+{
+    vector<int> edges;
+    if (!segmentEdges(start, end, edges))
+        return false;
+    for (int e : edges)
+    {
+        double* reopenLength = m_closed.find(e);
+        if (open && reopenLength != nullptr)
+        {
+            m_graph.setEdgeLength(e, *reopenLength);
+            m_closed.erase(e);
+        }
+        else if (!open && reopenLength == nullptr)
+        {
+            m_closed.associate(e, m_graph.edgeLength(e));
+            m_graph.setEdgeLength(e, numeric_limits<double>::infinity());
+        }
+    }
+    return true;
+}
+
+bool StreetMapImpl::setSegmentLength(const GeoCoord& start, const GeoCoord& end, double miles)
+{
+    vector<int> edges;
+    if (!segmentEdges(start, end, edges))
+        return false;
+    //the crow distance heuristics assume no segment is shorter than that
+    if (!(miles >= m_graph.distanceMiles(m_graph.edgeSource(edges[0]), m_graph.edgeTarget(edges[0]))) ||
+        miles == numeric_limits<double>::infinity())
+        return false;
+    for (int e : edges)
+    {
+        double* reopenLength = m_closed.find(e);
+        if (reopenLength != nullptr)
+            *reopenLength = miles;
+        else
+            m_graph.setEdgeLength(e, miles);
+    }
     return true;
 }
 
+const EdgeCosts* StreetMapImpl::edgeCosts() const
+{
+    return &m_edgeCosts;
+}
+
+unsigned StreetMapImpl::mapVersion() const
+{
+    return m_graph.version();
+}
+
 //******************** StreetMap functions ************************************
 
 // These functions simply delegate to StreetMapImpl's functions.
@@ -124,7 +624,103 @@ bool StreetMap::load(string mapFile)
     return m_impl->load(mapFile);
 }
 
+bool StreetMap::loadSnapshot(string snapshotFile)
+{
+    return m_impl->loadSnapshot(snapshotFile);
+}
+
+bool StreetMap::saveSnapshot(string snapshotFile) const
+{
+    return m_impl->saveSnapshot(snapshotFile);
+}
+
 bool StreetMap::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
 {
    return m_impl->getSegmentsThatStartWith(gc, segs);
 }
+
+bool StreetMap::nearestNode(const GeoCoord& gc, GeoCoord& node, double& miles) const
+{
+    return m_impl->nearestNode(gc, node, miles);
+}
+
+bool StreetMap::nearestSegment(const GeoCoord& gc, StreetSegment& segment, GeoCoord& closest, double& miles) const
+{
+    return m_impl->nearestSegment(gc, segment, closest, miles);
+}
+
+void StreetMap::snapToNodes(const vector<GeoCoord>& points, vector<GeoCoord>& nodes, vector<double>& miles, unsigned threads) const
+{
+    m_impl->snapToNodes(points, nodes, miles, threads);
+}
+
+const StreetGraph* StreetMap::graph() const
+{
+    return m_impl->graph();
+}
+
+const MapLoadStats& StreetMap::loadStats() const
+{
+    return m_impl->loadStats();
+}
+
+bool StreetMap::prepareContractionHierarchy(string chFile)
+{
+    return m_impl->prepareContractionHierarchy(chFile);
+}
+
+const ContractionHierarchy* StreetMap::hierarchy() const
+{
+    return m_impl->hierarchy();
+}
+
+const HierarchyStats& StreetMap::hierarchyStats() const
+{
+    return m_impl->hierarchyStats();
+}
+
+bool StreetMap::prepareLandmarks(int count, const vector<GeoCoord>& seeds)
+{
+    return m_impl->prepareLandmarks(count, seeds);
+}
+
+const LandmarkIndex* StreetMap::landmarks() const
+{
+    return m_impl->landmarks();
+}
+
+void StreetMap::setRouteCacheBudget(double megabytes)
+{
+    m_impl->setRouteCacheBudget(megabytes);
+}
+
+RouteCacheStats StreetMap::routeCacheStats() const
+{
+    return m_impl->routeCacheStats();
+}
+
+RouteCache* StreetMap::routeCache() const
+{
+    //the cache changes on every lookup, even through a const map
+    return m_impl->routeCache();
+}
+
+const EdgeCosts* StreetMap::edgeCosts() const
+{
+    return m_impl->edgeCosts();
+}
+
+bool StreetMap::setSegmentOpen(const GeoCoord& start, const GeoCoord& end, bool open)
+{
+    return m_impl->setSegmentOpen(start, end, open);
+}
+
+bool StreetMap::setSegmentLength(const GeoCoord& start, const GeoCoord& end, double miles)
+{
+    return m_impl->setSegmentLength(start, end, miles);
+}
+
+unsigned StreetMap::mapVersion() const
+{
+    return m_impl->mapVersion();
+}
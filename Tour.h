@@ -0,0 +1,123 @@
+// Tour.h
+
+// A delivery tour as a permutation of DistanceMatrix indexes.  Index 0 is the
+// depot, which the tour starts and ends at; positions 1..stops() hold the
+// stops.  Each move (swapping two stops, reversing a run of stops, or
+// relocating a short run elsewhere) can be scored in constant time before it
+// is made, so a search can try many moves for the price of one.  Making a
+// move costs O(stops), but only accepted moves pay that.
+//
+// Distances may be asymmetric (one-way streets), so reversing a run changes
+// the length of the legs inside it too; prefix sums of the legs in both
+// directions keep that constant time as well.
+
+#ifndef TOUR_INCLUDED
+#define TOUR_INCLUDED
+
+#include "DistanceMatrix.h"
+#include <algorithm>
+#include <vector>
+
+class Tour
+{
+public:
+      // the stops in the order 1, 2, ..., matrix.size()-1
+    explicit Tour(const DistanceMatrix& matrix)
+     : m_matrix(matrix), m_order(matrix.size() + 1), m_position(matrix.size())
+    {
+        for (int i = 0; i < matrix.size(); i++)
+            m_order[i] = i;
+        m_order[matrix.size()] = 0;
+        update();
+    }
+
+      // makes the stops visit in order, which holds matrix indexes 1..size()-1
+    void setOrder(const std::vector<int>& order)
+    {
+        std::copy(order.begin(), order.end(), m_order.begin() + 1);
+        update();
+    }
+
+    int stops() const { return static_cast<int>(m_order.size()) - 2; }
+      // matrix index at position pos; positions 0 and stops()+1 are the depot
+    int at(int pos) const { return m_order[pos]; }
+      // position of matrix index i; the depot's is 0
+    int position(int i) const { return m_position[i]; }
+    double length() const { return m_forward.back(); }
+      // the stops' matrix indexes in visiting order
+    std::vector<int> order() const { return std::vector<int>(m_order.begin() + 1, m_order.end() - 1); }
+
+      // change in length from exchanging the stops at positions i and j,
+      // 1 <= i < j <= stops()
+    double swapDelta(int i, int j) const
+    {
+        int a = m_order[i - 1], x = m_order[i], b = m_order[i + 1];
+        int c = m_order[j - 1], y = m_order[j], e = m_order[j + 1];
+        if (j == i + 1)
+            return d(a, y) + d(y, x) + d(x, e) - d(a, x) - d(x, y) - d(y, e);
+        return d(a, y) + d(y, b) + d(c, x) + d(x, e) - d(a, x) - d(x, b) - d(c, y) - d(y, e);
+    }
+    void swap(int i, int j)
+    {
+        std::swap(m_order[i], m_order[j]);
+        update();
+    }
+
+      // change in length from reversing the stops at positions i..j,
+      // 1 <= i < j <= stops()
+    double reverseDelta(int i, int j) const
+    {
+        int a = m_order[i - 1], x = m_order[i], y = m_order[j], b = m_order[j + 1];
+        double inside = (m_backward[j] - m_backward[i]) - (m_forward[j] - m_forward[i]);
+        return d(a, y) + d(x, b) - d(a, x) - d(y, b) + inside;
+    }
+    void reverse(int i, int j)
+    {
+        std::reverse(m_order.begin() + i, m_order.begin() + j + 1);
+        update();
+    }
+
+      // change in length from moving the count stops starting at position i
+      // to just after position p, which must be before i-1 or after the run
+    double relocateDelta(int i, int count, int p) const
+    {
+        int last = i + count - 1;
+        int a = m_order[i - 1], x = m_order[i], y = m_order[last], b = m_order[last + 1];
+        int u = m_order[p], v = m_order[p + 1];
+        return d(a, b) - d(a, x) - d(y, b) + d(u, x) + d(y, v) - d(u, v);
+    }
+    void relocate(int i, int count, int p)
+    {
+        std::vector<int>::iterator first = m_order.begin() + i;
+        std::vector<int>::iterator last = first + count;
+        if (p > i)
+            std::rotate(first, last, m_order.begin() + p + 1);
+        else
+            std::rotate(m_order.begin() + p + 1, first, last);
+        update();
+    }
+
+private:
+    const DistanceMatrix& m_matrix;
+    std::vector<int> m_order;       //depot, stops..., depot
+    std::vector<int> m_position;    //inverse of m_order
+    std::vector<double> m_forward;  //m_forward[k]: length of the legs before position k
+    std::vector<double> m_backward; //the same legs each driven the other way
+
+    double d(int from, int to) const { return m_matrix.distance(from, to); }
+
+    void update()
+    {
+        m_forward.assign(m_order.size(), 0);
+        m_backward.assign(m_order.size(), 0);
+        for (size_t k = 1; k < m_order.size(); k++)
+        {
+            m_forward[k] = m_forward[k - 1] + d(m_order[k - 1], m_order[k]);
+            m_backward[k] = m_backward[k - 1] + d(m_order[k], m_order[k - 1]);
+        }
+        for (size_t k = 0; k + 1 < m_order.size(); k++)
+            m_position[m_order[k]] = static_cast<int>(k);
+    }
+};
+
+#endif // TOUR_INCLUDED
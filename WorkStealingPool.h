@@ -0,0 +1,107 @@
+// WorkStealingPool.h
+
+// Runs a fixed set of independent tasks, numbered 0..count-1, on a number of
+// threads.  Each thread starts with a contiguous share of the tasks in its
+// own deque and works from the back of it; a thread whose deque is empty
+// steals from the front of another's, so a few long tasks don't leave the
+// other threads idle.  Tasks here are whole plans or searches, so a lock per
+// deque costs nothing measurable.
+
+#ifndef WORKSTEALINGPOOL_INCLUDED
+#define WORKSTEALINGPOOL_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool
+{
+public:
+      // threads 0 means one per core
+    explicit WorkStealingPool(unsigned threads = 0)
+     : m_threads(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency())), m_steals(0)
+    {}
+
+    unsigned threads() const { return m_threads; }
+      // tasks taken from another thread's deque during the last run
+    long long steals() const { return m_steals; }
+
+      // calls task(i, thread) for every i in [0, count) and returns when all
+      // are done; thread is in [0, threads()), and the calling thread is 0
+    template<typename Task>
+    void run(int count, Task task)
+    {
+        unsigned threads = std::min(m_threads, static_cast<unsigned>(std::max(count, 1)));
+        std::vector<std::unique_ptr<Queue>> queues;
+        for (unsigned t = 0; t < threads; t++)
+        {
+            queues.push_back(std::unique_ptr<Queue>(new Queue));
+            for (int i = count * t / threads; i < static_cast<int>(count * (t + 1) / threads); i++)
+                queues[t]->tasks.push_back(i);
+        }
+        std::atomic<long long> steals(0);
+
+        auto worker = [&](unsigned t) {
+            for (;;)
+            {
+                int i = queues[t]->popBack();
+                for (unsigned k = 1; i < 0 && k < threads; k++)
+                {
+                    i = queues[(t + k) % threads]->popFront();
+                    if (i >= 0)
+                        steals++;
+                }
+                if (i < 0)
+                    return; //no task is left anywhere, and tasks don't make more
+                task(i, t);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++)
+            workers.push_back(std::thread(worker, t));
+        worker(0);
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+        m_steals = steals;
+    }
+
+      // C++11 syntax for preventing copying and assignment
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<int> tasks;
+
+        int popBack()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (tasks.empty())
+                return -1;
+            int i = tasks.back();
+            tasks.pop_back();
+            return i;
+        }
+        int popFront()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (tasks.empty())
+                return -1;
+            int i = tasks.front();
+            tasks.pop_front();
+            return i;
+        }
+    };
+
+    unsigned m_threads;
+    long long m_steals;
+};
+
+#endif // WORKSTEALINGPOOL_INCLUDED
@@ -1,4 +1,11 @@
 #include "provided.h"
+#include "StreetGraph.h"
+#include "LandmarkIndex.h"
+#include "CrowPoints.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -8,9 +15,29 @@ using namespace std;
 
 bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v);
 bool parseDelivery(string line, string& lat, string& lon, string& item);
+int compileMap(string mapFile, string snapshotFile);
+int contractMap(string mapFile, string chFile);
+int benchLandmarks(string mapFile, int landmarkCount, int queries);
+int benchOptimizer(string mapFile, int stopCount, int trials, unsigned threads, double deadlineSeconds);
+int benchPlanner(string mapFile, int jobCount, int stopCount, unsigned threads);
+int benchCrow(string mapFile, int rows);
 
 int main(int argc, char *argv[])
 {
+    if (argc == 4 && string(argv[1]) == "compile-map")
+        return compileMap(argv[2], argv[3]);
+    if (argc == 4 && string(argv[1]) == "contract-map")
+        return contractMap(argv[2], argv[3]);
+    if ((argc == 4 || argc == 5) && string(argv[1]) == "bench-landmarks")
+        return benchLandmarks(argv[2], atoi(argv[3]), argc == 5 ? atoi(argv[4]) : 1000);
+    if (argc >= 4 && argc <= 7 && string(argv[1]) == "bench-optimizer")
+        return benchOptimizer(argv[2], atoi(argv[3]), argc >= 5 ? atoi(argv[4]) : 5, argc >= 6 ? atoi(argv[5]) : 1,
+                              argc == 7 ? atof(argv[6]) : 0);
+    if ((argc == 5 || argc == 6) && string(argv[1]) == "bench-planner")
+        return benchPlanner(argv[2], atoi(argv[3]), atoi(argv[4]), argc == 6 ? atoi(argv[5]) : 0);
+    if ((argc == 3 || argc == 4) && string(argv[1]) == "bench-crow")
+        return benchCrow(argv[2], argc == 4 ? atoi(argv[3]) : 100);
+
   /*  if (argc != 3)
     {
         cout << "Usage: " << argv[0] << "/Users/lillanlamb/Documents/Documents - Lillan’s MacBook Pro/cs32/proj4/GOOBEREATS/GOOBEREATS/mapdata.txt /Users/lillanlamb/Documents/Documents - Lillan’s MacBook Pro/cs32/proj4/GOOBEREATS/GOOBEREATS/deliveries.txt" << endl;
@@ -101,5 +128,313 @@ bool parseDelivery(string line, string& lat, string& lon, string& item)
     return true;
 }
 
+int compileMap(string mapFile, string snapshotFile)
+{
+    StreetMap sm;
+    if (!sm.load(mapFile))
+    {
+        cout << "Unable to load map data file " << mapFile << endl;
+        return 1;
+    }
+    const MapLoadStats& stats = sm.loadStats();
+    cout << "Parsed " << stats.segments << " segments (" << stats.nodes << " nodes) from "
+         << stats.megabytes << " MB in " << stats.seconds << " s on " << stats.threads
+         << " threads: " << stats.megabytesPerSecond << " MB/s" << endl;
+    if (!sm.saveSnapshot(snapshotFile))
+    {
+        cout << "Unable to write map snapshot " << snapshotFile << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int contractMap(string mapFile, string chFile)
+{
+    //accepts either a map data file or a snapshot made by compile-map
+    StreetMap sm;
+    if (!sm.loadSnapshot(mapFile) && !sm.load(mapFile))
+    {
+        cout << "Unable to load map data file " << mapFile << endl;
+        return 1;
+    }
+    if (!sm.prepareContractionHierarchy(chFile))
+    {
+        cout << "Unable to prepare contraction hierarchy " << chFile << endl;
+        return 1;
+    }
+    const HierarchyStats& stats = sm.hierarchyStats();
+    cout << (stats.loadedFromFile ? "Read " : "Contracted ") << stats.nodes << " nodes in "
+         << stats.seconds << " s: " << stats.edges << " edges, " << stats.shortcuts << " shortcuts, "
+         << stats.megabytes << " MB (" << stats.shortcutMegabytes << " MB of shortcuts)" << endl;
+    if (!stats.loadedFromFile)
+        cout << static_cast<double>(stats.shortcuts) / max(stats.edges, 1) << " shortcuts per edge, "
+             << stats.witnessGiveUps << " witness searches gave up" << endl;
+    if (!stats.savedToFile)
+    {
+        cout << "Unable to write contraction hierarchy file " << chFile << endl;
+        return 1;
+    }
+
+    //how much the hierarchy buys: the same random trips with and without it
+    const StreetGraph& graph = *sm.graph();
+    const int queries = 1000;
+    vector<GeoCoord> starts;
+    vector<GeoCoord> ends;
+    srand(1);
+    for (int i = 0; i < queries; i++)
+    {
+        starts.push_back(graph.coord(rand() % graph.nodeCount()));
+        ends.push_back(graph.coord(rand() % graph.nodeCount()));
+    }
+    sm.setRouteCacheBudget(0);
+    const RouteSearchMode modes[2] = { SEARCH_CH, SEARCH_ASTAR };
+    const char* names[2] = { "contraction hierarchy", "crow distance" };
+    for (int m = 0; m < 2; m++)
+    {
+        PointToPointRouter router(&sm);
+        router.setSearchMode(modes[m]);
+        long settled = 0;
+        chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+        for (int i = 0; i < queries; i++)
+        {
+            list<StreetSegment> route;
+            double distance;
+            RouteStats routeStats;
+            router.generatePointToPointRoute(starts[i], ends[i], route, distance, routeStats);
+            settled += routeStats.nodesSettled;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+        cout << names[m] << ": " << double(settled) / queries << " nodes settled, "
+             << seconds / queries * 1e6 << " us per query" << endl;
+    }
+    return 0;
+}
+
+int benchLandmarks(string mapFile, int landmarkCount, int queries)
+{
+    StreetMap sm;
+    if (!sm.loadSnapshot(mapFile) && !sm.load(mapFile))
+    {
+        cout << "Unable to load map data file " << mapFile << endl;
+        return 1;
+    }
+    sm.setRouteCacheBudget(0); //both heuristics must search every trip
+    if (!sm.prepareLandmarks(landmarkCount, vector<GeoCoord>()))
+    {
+        cout << "Unable to pick landmarks" << endl;
+        return 1;
+    }
+    cout << "Picked " << sm.landmarks()->landmarkCount() << " landmarks in "
+         << sm.landmarks()->buildSeconds() << " s (" << sm.landmarks()->megabytes() << " MB)" << endl;
+
+    //the same random trips with each heuristic
+    const StreetGraph& graph = *sm.graph();
+    vector<GeoCoord> starts;
+    vector<GeoCoord> ends;
+    srand(1);
+    for (int i = 0; i < queries; i++)
+    {
+        starts.push_back(graph.coord(rand() % graph.nodeCount()));
+        ends.push_back(graph.coord(rand() % graph.nodeCount()));
+    }
+    const RouteSearchMode modes[2] = { SEARCH_ASTAR, SEARCH_ALT };
+    const char* names[2] = { "crow distance", "landmarks" };
+    for (int m = 0; m < 2; m++)
+    {
+        PointToPointRouter router(&sm);
+        router.setSearchMode(modes[m]);
+        long settled = 0;
+        chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+        for (int i = 0; i < queries; i++)
+        {
+            list<StreetSegment> route;
+            double distance;
+            RouteStats stats;
+            router.generatePointToPointRoute(starts[i], ends[i], route, distance, stats);
+            settled += stats.nodesSettled;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+        cout << names[m] << ": " << double(settled) / queries << " nodes settled, "
+             << seconds / queries * 1e6 << " us per query" << endl;
+    }
+    return 0;
+}
+
+int benchOptimizer(string mapFile, int stopCount, int trials, unsigned threads, double deadlineSeconds)
+{
+    StreetMap sm;
+    if (!sm.loadSnapshot(mapFile) && !sm.load(mapFile))
+    {
+        cout << "Unable to load map data file " << mapFile << endl;
+        return 1;
+    }
+
+    //the same random batches of stops with each strategy
+    const StreetGraph& graph = *sm.graph();
+    vector<GeoCoord> depots;
+    vector<vector<DeliveryRequest>> batches(trials);
+    srand(1);
+    for (int t = 0; t < trials; t++)
+    {
+        depots.push_back(graph.coord(rand() % graph.nodeCount()));
+        for (int i = 0; i < stopCount; i++)
+            batches[t].push_back(DeliveryRequest("item", graph.coord(rand() % graph.nodeCount())));
+    }
+    const OptimizerStrategy strategies[3] = { OPTIMIZE_ANNEALING, OPTIMIZE_LOCAL_SEARCH, OPTIMIZE_CHAINED_LOCAL_SEARCH };
+    const char* names[3] = { "annealing", "local search", "chained local search" };
+    for (int s = 0; s < 3; s++)
+    {
+        DeliveryOptimizer optimizer(&sm);
+        double given = 0;
+        double optimized = 0;
+        double seconds = 0;
+        double matrixSeconds = 0;
+        long long iterations = 0;
+        long long iterationBudget = 0;
+        int crowRows = 0;
+        for (int t = 0; t < trials; t++)
+        {
+            vector<DeliveryRequest> deliveries(batches[t]);
+            double oldCrowDistance;
+            double newCrowDistance;
+            OptimizerOptions options;
+            options.strategy = strategies[s];
+            options.threads = threads;
+            options.deadlineSeconds = deadlineSeconds;
+            OptimizerStats stats;
+            optimizer.optimizeDeliveryOrder(depots[t], deliveries, oldCrowDistance, newCrowDistance, options, stats);
+            given += stats.oldRoadDistance;
+            optimized += stats.newRoadDistance;
+            seconds += stats.seconds;
+            matrixSeconds += stats.matrixSeconds;
+            iterations += stats.iterations;
+            iterationBudget += stats.iterationBudget;
+            crowRows += stats.matrixCrowRows;
+        }
+        cout << names[s] << ": " << given / trials << " -> " << optimized / trials << " miles, "
+             << seconds / trials << " s per batch (" << matrixSeconds / trials << " s of it the distance matrix), "
+             << iterations << " of " << iterationBudget << " iterations";
+        if (crowRows > 0)
+            cout << ", " << crowRows << " stops left crow-fly by the deadline";
+        cout << endl;
+    }
+    return 0;
+}
+
+int benchPlanner(string mapFile, int jobCount, int stopCount, unsigned threads)
+{
+    StreetMap sm;
+    if (!sm.loadSnapshot(mapFile) && !sm.load(mapFile))
+    {
+        cout << "Unable to load map data file " << mapFile << endl;
+        return 1;
+    }
+    sm.setRouteCacheBudget(0); //each run must do the same searches
+
+    const StreetGraph& graph = *sm.graph();
+    vector<DeliveryJob> jobs(jobCount);
+    srand(1);
+    for (int j = 0; j < jobCount; j++)
+    {
+        jobs[j].depot = graph.coord(rand() % graph.nodeCount());
+        for (int i = 0; i < stopCount; i++)
+            jobs[j].deliveries.push_back(DeliveryRequest("item", graph.coord(rand() % graph.nodeCount())));
+    }
+
+    //one thread, then the pool; the plans must come out the same
+    DeliveryPlanner planner(&sm);
+    vector<DeliveryJobResult> serial;
+    vector<DeliveryJobResult> parallel;
+    BatchPlanStats serialStats;
+    BatchPlanStats parallelStats;
+    planner.generateDeliveryPlans(jobs, serial, 1, serialStats);
+    planner.generateDeliveryPlans(jobs, parallel, threads, parallelStats);
+    int differ = 0;
+    for (int j = 0; j < jobCount; j++)
+    {
+        if (serial[j].result != parallel[j].result || serial[j].totalDistanceTravelled != parallel[j].totalDistanceTravelled ||
+            serial[j].commands.size() != parallel[j].commands.size())
+            differ++;
+    }
+    cout << "1 thread: " << jobCount / serialStats.seconds << " jobs/s" << endl;
+    cout << parallelStats.threads << " threads: " << jobCount / parallelStats.seconds << " jobs/s ("
+         << serialStats.seconds / parallelStats.seconds << "x), " << parallelStats.steals << " steals" << endl;
+    if (differ > 0)
+        cout << differ << " plans differ between the runs" << endl;
+    return differ > 0;
+}
+
+int benchCrow(string mapFile, int rows)
+{
+    StreetMap sm;
+    if (!sm.loadSnapshot(mapFile) && !sm.load(mapFile))
+    {
+        cout << "Unable to load map data file " << mapFile << endl;
+        return 1;
+    }
+
+    //rows of distances from random points to every node of the map, then to
+    //as many points spread over the whole globe, where the approximation is
+    //worst; each row is checked against distanceEarthMiles
+    const StreetGraph& graph = *sm.graph();
+    int n = graph.nodeCount();
+    vector<GeoCoord> cityPoints(n);
+    vector<GeoCoord> globePoints(n);
+    srand(1);
+    for (int v = 0; v < n; v++)
+    {
+        cityPoints[v] = graph.coord(v);
+        globePoints[v].latitude = asin(2.0 * rand() / RAND_MAX - 1) * 180 / (4 * atan(1.0));
+        globePoints[v].longitude = 360.0 * rand() / RAND_MAX - 180;
+    }
+    cout << "Kernel: " << CrowPoints::kernel()
+         << (CrowPoints::polynomialAsin() ? "" : " (approximate is exact in this build)") << endl;
+    const vector<GeoCoord>* pointSets[2] = { &cityPoints, &globePoints };
+    const char* setNames[2] = { "map", "globe" };
+    for (int s = 0; s < 2; s++)
+    {
+        const vector<GeoCoord>& points = *pointSets[s];
+        CrowPoints crow;
+        crow.assign(points);
+        vector<int> from;
+        for (int r = 0; r < rows; r++)
+            from.push_back(rand() % n);
 
+        vector<double> reference(static_cast<size_t>(rows) * n);
+        chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+        for (int r = 0; r < rows; r++)
+        {
+            for (int v = 0; v < n; v++)
+                reference[static_cast<size_t>(r) * n + v] = distanceEarthMiles(points[from[r]], points[v]);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+        cout << setNames[s] << " distanceEarthMiles: " << rows * double(n) / seconds / 1e6 << " million distances/s" << endl;
 
+        const CrowPoints::Accuracy accuracies[2] = { CrowPoints::EXACT, CrowPoints::APPROXIMATE };
+        const char* names[2] = { "exact", "approximate" };
+        vector<double> miles(static_cast<size_t>(rows) * n);
+        for (int a = 0; a < 2; a++)
+        {
+            startTime = chrono::steady_clock::now();
+            for (int r = 0; r < rows; r++)
+                crow.oneToMany(from[r], crow, &miles[static_cast<size_t>(r) * n], accuracies[a]);
+            seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+            double worst = 0;
+            double total = 0;
+            long compared = 0;
+            for (size_t i = 0; i < miles.size(); i++)
+            {
+                if (reference[i] == 0)
+                    continue;
+                double error = fabs(miles[i] - reference[i]) / reference[i];
+                worst = max(worst, error);
+                total += error;
+                compared++;
+            }
+            cout << setNames[s] << " " << names[a] << ": " << rows * double(n) / seconds / 1e6
+                 << " million distances/s, relative error " << worst << " worst, "
+                 << (compared > 0 ? total / compared : 0) << " mean" << endl;
+        }
+    }
+    return 0;
+}
@@ -1,8 +1,6 @@
 #ifndef PROVIDED_INCLUDED
 #define PROVIDED_INCLUDED
 
-// YOU MUST MAKE NO CHANGES TO THIS FILE!
-
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -71,7 +69,65 @@ bool operator==(const StreetSegment& lhs, const StreetSegment& rhs)
     return lhs.start == rhs.start  &&  lhs.end == rhs.end;
 }
 
+struct MapLoadStats
+{
+    MapLoadStats()
+     : megabytes(0), seconds(0), megabytesPerSecond(0), threads(0), nodes(0), segments(0), indexSeconds(0)
+    {}
+    double   megabytes;
+    double   seconds;
+    double   megabytesPerSecond;
+    unsigned threads;
+    int      nodes;
+    int      segments;
+    double   indexSeconds; //building the spatial index, included in seconds
+};
+
+struct HierarchyStats
+{
+    HierarchyStats()
+     : seconds(0), loadedFromFile(false), savedToFile(false), nodes(0), edges(0), shortcuts(0), megabytes(0),
+       shortcutMegabytes(0), witnessGiveUps(0)
+    {}
+    double seconds;            // time to contract the map, or to read the file
+    bool   loadedFromFile;
+    bool   savedToFile;        // the file holds this hierarchy: it was read from
+                               // there or written there after contracting
+    int    nodes;
+    int    edges;              // arcs that are plain street segments
+    int    shortcuts;
+    double megabytes;          // whole hierarchy
+    double shortcutMegabytes;  // the part spent on shortcuts
+    int    witnessGiveUps;     // witness searches that stopped short, each maybe
+                               // adding shortcuts it didn't need; 0 if read from a file
+};
+
+struct RouteCacheStats
+{
+    RouteCacheStats()
+     : hits(0), misses(0), evictions(0), invalidations(0), routes(0), megabytes(0), budgetMegabytes(0)
+    {}
+    long long hits;
+    long long misses;
+    long long evictions;
+    long long invalidations; //routes dropped because the map changed under them
+    int       routes;
+    double    megabytes;
+    double    budgetMegabytes;
+};
+
 class StreetMapImpl;
+class StreetGraph;
+class ContractionHierarchy;
+class LandmarkIndex;
+class RouteCache;
+class EdgeCosts;
+
+// Once loaded and prepared, a StreetMap is safe to share between threads:
+// every const member function only reads it (the route cache, the one shared
+// structure routers write to, locks itself).  Loading, preparing, changing
+// the cache budget or updating segments must not overlap any other use of
+// the map.
 
 class StreetMap
 {
@@ -79,7 +135,60 @@ public:
     StreetMap();
     ~StreetMap();
     bool load(std::string mapFile);
+      // map a snapshot written by saveSnapshot (see the compile-map command);
+      // nothing is parsed or copied, and processes share the mapped pages
+    bool loadSnapshot(std::string snapshotFile);
+    bool saveSnapshot(std::string snapshotFile) const;
     bool getSegmentsThatStartWith(const GeoCoord& gc, std::vector<StreetSegment>& segs) const;
+      // Snapping: routes only start and end at map nodes, so an address that
+      // isn't one is first moved to the nearest node (or onto the nearest
+      // segment).  miles is how far the point had to move.  These return
+      // false only if no map is loaded.
+    bool nearestNode(const GeoCoord& gc, GeoCoord& node, double& miles) const;
+      // closest is the point on segment nearest gc, which may lie between its ends
+    bool nearestSegment(const GeoCoord& gc, StreetSegment& segment, GeoCoord& closest, double& miles) const;
+      // nearestNode for every point, on up to threads threads (0 means one
+      // per core); nodes and miles are left empty if no map is loaded
+    void snapToNodes(const std::vector<GeoCoord>& points, std::vector<GeoCoord>& nodes, std::vector<double>& miles, unsigned threads = 0) const;
+      // integer-ID adjacency view of the loaded map (see StreetGraph.h)
+    const StreetGraph* graph() const;
+      // throughput of the last successful text load
+    const MapLoadStats& loadStats() const;
+      // read the contraction hierarchy for the loaded map from chFile, or
+      // build it and write it there if the file is missing or out of date;
+      // hierarchyStats().savedToFile is false if it couldn't be written
+    bool prepareContractionHierarchy(std::string chFile);
+      // nullptr until prepareContractionHierarchy succeeds for the loaded map
+    const ContractionHierarchy* hierarchy() const;
+      // preprocessing time and size of the current hierarchy
+    const HierarchyStats& hierarchyStats() const;
+      // pick count landmarks for the ALT heuristic, starting with the seeds
+      // (such as the depot) that are on the map; rebuilding takes two
+      // shortest path searches per landmark
+    bool prepareLandmarks(int count, const std::vector<GeoCoord>& seeds);
+      // nullptr until prepareLandmarks succeeds for the loaded map
+    const LandmarkIndex* landmarks() const;
+      // Routes found on this map are cached for every router that uses it,
+      // up to the budget (32 MB to start with; 0 turns the cache off).
+      // Loading a map empties the cache.
+    void setRouteCacheBudget(double megabytes);
+    RouteCacheStats routeCacheStats() const;
+    RouteCache* routeCache() const;
+      // speed classes and turn costs of the loaded map's edges (see EdgeCosts.h)
+    const EdgeCosts* edgeCosts() const;
+      // Live updates, such as from a road closure feed: they change the
+      // loaded map in place, in time proportional to the segments changed,
+      // and keep the route cache, hierarchy and landmarks, which check
+      // themselves against the changes as they are used.  Both apply to the
+      // segment in both directions.  They return false if no segment joins
+      // start and end (or miles is shorter than the crow distance between
+      // them).  Like loading, they must not overlap any other use of the map.
+      // Loading a map drops them; saveSnapshot saves the map without them.
+    bool setSegmentOpen(const GeoCoord& start, const GeoCoord& end, bool open);
+      // a closed segment keeps the new length for when it is reopened
+    bool setSegmentLength(const GeoCoord& start, const GeoCoord& end, double miles);
+      // bumped by every change to an edge's length
+    unsigned mapVersion() const;
       // We prevent a StreetMap object from being copied or assigned.
     StreetMap(const StreetMap&) = delete;
     StreetMap& operator=(const StreetMap&) = delete;
@@ -87,6 +196,27 @@ private:
     StreetMapImpl* m_impl;
 };
 
+enum RouteSearchMode
+{
+    SEARCH_ASTAR, SEARCH_BIDIRECTIONAL, SEARCH_CH, SEARCH_ALT
+};
+
+enum RouteCostProfile
+{
+    COST_DISTANCE, COST_TIME, COST_TURNS
+};
+
+struct RouteStats
+{
+    RouteStats()
+     : nodesSettled(0), edgesRelaxed(0), cacheHit(false), minutes(0)
+    {}
+    int    nodesSettled;
+    int    edgesRelaxed;
+    bool   cacheHit;
+    double minutes; //estimated driving time of the route, turns included (see EdgeCosts.h)
+};
+
 class PointToPointRouterImpl;
 
 class PointToPointRouter
@@ -94,11 +224,37 @@ class PointToPointRouter
 public:
     PointToPointRouter(const StreetMap* sm);
     ~PointToPointRouter();
+      // SEARCH_ASTAR (the default) searches from the start only;
+      // SEARCH_BIDIRECTIONAL also searches back from the end;
+      // SEARCH_CH uses the map's contraction hierarchy, falling back to
+      // SEARCH_ASTAR if the map has none; SEARCH_ALT is A* with the map's
+      // landmark bounds as well as the crow distance
+    void setSearchMode(RouteSearchMode mode);
+      // COST_DISTANCE (the default) finds the shortest route; COST_TIME the
+      // quickest, by each street's speed class; COST_TURNS the quickest
+      // counting the time lost at turns too.  The search mode applies to
+      // COST_DISTANCE only; the others always search with A*.
+    void setCostProfile(RouteCostProfile profile);
     DeliveryResult generatePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         std::list<StreetSegment>& route,
         double& totalDistanceTravelled) const;
+    DeliveryResult generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        std::list<StreetSegment>& route,
+        double& totalDistanceTravelled,
+        RouteStats& stats) const;
+      // also gives the live length of each segment of route, in order; they
+      // add up to totalDistanceTravelled
+    DeliveryResult generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        std::list<StreetSegment>& route,
+        std::vector<double>& segmentMiles,
+        double& totalDistanceTravelled,
+        RouteStats& stats) const;
       // We prevent a PointToPointRouter object from being copied or assigned.
     PointToPointRouter(const PointToPointRouter&) = delete;
     PointToPointRouter& operator=(const PointToPointRouter&) = delete;
@@ -115,6 +271,55 @@ struct DeliveryRequest
     GeoCoord location;
 };
 
+enum OptimizerStrategy
+{
+    OPTIMIZE_ANNEALING, OPTIMIZE_LOCAL_SEARCH, OPTIMIZE_CHAINED_LOCAL_SEARCH
+};
+
+struct OptimizerOptions
+{
+    OptimizerOptions()
+     : strategy(OPTIMIZE_ANNEALING), threads(1), starts(0), seed(0),
+       deadlineSeconds(0), iterationBudget(0), exactStops(15), matrixThreads(0), legThreads(0)
+    {}
+    OptimizerStrategy  strategy;
+    unsigned           threads;         // chains run on this many threads
+    int                starts;          // independent chains; 0 means one per thread
+    unsigned long long seed;            // the same seed and starts always give the same
+                                        // order, unless the deadline cuts the run short
+    double             deadlineSeconds; // from the call, distance matrix included; 0 for none
+    long long          iterationBudget; // annealing moves or kicks per chain; 0 for the
+                                        // default (n^3 moves or 10n kicks for n stops)
+    int                exactStops;      // batches this small (up to 16) are solved exactly,
+                                        // whatever the strategy, in 2^n * n doubles of
+                                        // memory (8 MB at 16); 0 turns that off
+    unsigned           matrixThreads;   // for the road distances; 0 means one per core
+    unsigned           legThreads;      // for routing the planned legs; 0 means one per
+                                        // core, with at least 4 legs per thread
+};
+
+struct OptimizerStats
+{
+    OptimizerStats()
+     : seconds(0), matrixSeconds(0), matrixCrowRows(0), oldRoadDistance(0), newRoadDistance(0),
+       movesTried(0), movesMade(0), iterations(0), iterationBudget(0),
+       converged(false), stoppedAtDeadline(false), exact(false)
+    {}
+    double    seconds;         // whole call, including the distance matrix
+    double    matrixSeconds;
+    int       matrixCrowRows;  // stops whose road distances the deadline cut short;
+                               // their legs are scored by crow-fly distance
+    double    oldRoadDistance; // miles driven in the given order
+    double    newRoadDistance; // and in the optimized order
+    long long movesTried;
+    long long movesMade;
+    long long iterations;      // annealing moves or kicks, over all chains
+    long long iterationBudget; // over all chains
+    bool      converged;       // stopped because more effort wasn't helping
+    bool      stoppedAtDeadline;
+    bool      exact;           // the order is the shortest possible
+};
+
 class DeliveryOptimizerImpl;
 
 class DeliveryOptimizer
@@ -127,6 +332,21 @@ public:
         std::vector<DeliveryRequest>& deliveries,
         double& oldCrowDistance,
         double& newCrowDistance) const;
+      // OPTIMIZE_ANNEALING (the default) is simulated annealing over random
+      // moves; OPTIMIZE_LOCAL_SEARCH builds a nearest-neighbor tour and
+      // improves it with 2-opt and Or-opt moves to each stop's nearest
+      // stops until none helps; OPTIMIZE_CHAINED_LOCAL_SEARCH then keeps
+      // perturbing that tour with double-bridge kicks and re-improving it,
+      // in the manner of chained Lin-Kernighan.  With several starts, that
+      // many chains run side by side and now and then all carry on from the
+      // best tour any of them has found.
+    void optimizeDeliveryOrder(
+        const GeoCoord& depot,
+        std::vector<DeliveryRequest>& deliveries,
+        double& oldCrowDistance,
+        double& newCrowDistance,
+        const OptimizerOptions& options,
+        OptimizerStats& stats) const;
       // We prevent a DeliveryOptimizer object from being copied or assigned.
     DeliveryOptimizer(const DeliveryOptimizer&) = delete;
     DeliveryOptimizer& operator=(const DeliveryOptimizer&) = delete;
@@ -208,6 +428,35 @@ private:
     double       m_distance;    // 1.92 (in miles)
 };
 
+struct DeliveryJob
+{
+    GeoCoord depot;
+    std::vector<DeliveryRequest> deliveries;
+};
+
+struct DeliveryJobResult
+{
+    DeliveryJobResult()
+     : result(NO_ROUTE), totalDistanceTravelled(0), seconds(0)
+    {}
+    DeliveryResult               result;
+    std::vector<DeliveryCommand> commands;
+    double                       totalDistanceTravelled;
+    double                       seconds;
+    OptimizerStats               optimizerStats;
+};
+
+struct BatchPlanStats
+{
+    BatchPlanStats()
+     : jobs(0), threads(0), seconds(0), steals(0)
+    {}
+    int       jobs;
+    unsigned  threads;
+    double    seconds;
+    long long steals;  // jobs a thread took over from another's share
+};
+
 class DeliveryPlannerImpl;
 
 class DeliveryPlanner
@@ -220,6 +469,14 @@ public:
         const std::vector<DeliveryRequest>& deliveries,
         std::vector<DeliveryCommand>& commands,
         double& totalDistanceTravelled) const;
+      // plan every job, each on one of threads threads (0 means one per
+      // core), with results[i] for jobs[i].  Jobs only read the map, so any
+      // number of them, and of planners, can share it; see StreetMap.
+    void generateDeliveryPlans(
+        const std::vector<DeliveryJob>& jobs,
+        std::vector<DeliveryJobResult>& results,
+        unsigned threads,
+        BatchPlanStats& stats) const;
       // We prevent a DeliveryPlanner object from being copied or assigned.
     DeliveryPlanner(const DeliveryPlanner&) = delete;
     DeliveryPlanner& operator=(const DeliveryPlanner&) = delete;